@@ -0,0 +1,233 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+// configure with -DAOC23_ALLOCATION_STATS=ON to count the allocations of every executable: the global operator new and
+// delete are replaced by counting hooks then and the driver reports the allocations of each phase (see
+// allocation_phase) on stderr. the replacements are defined in this header, which is fine as long as every day is a
+// single translation unit
+#ifndef QUXFLUX_ALLOCATION_STATS
+#define QUXFLUX_ALLOCATION_STATS 0
+#endif
+
+namespace quxflux {
+
+struct allocation_stats {
+    std::string name;
+    size_t num_allocations = 0;
+    size_t num_bytes = 0;
+    size_t peak_live_bytes = 0;
+};
+
+// the peak resident set size of the process in bytes, std::nullopt where it can't be queried
+inline std::optional<size_t> peak_resident_set_size()
+{
+#if defined(__unix__) || defined(__APPLE__)
+    rusage usage {};
+    if (::getrusage(RUSAGE_SELF, &usage) != 0)
+        return std::nullopt;
+
+#if defined(__APPLE__)
+    return static_cast<size_t>(usage.ru_maxrss);
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#else
+    return std::nullopt;
+#endif
+}
+
+#if QUXFLUX_ALLOCATION_STATS
+
+namespace detail {
+    // process wide, the parallel algorithms allocate on threads of their own
+    struct allocation_counters {
+        std::atomic<size_t> num_allocations = 0;
+        std::atomic<size_t> num_bytes = 0;
+        std::atomic<size_t> live_bytes = 0;
+        std::atomic<size_t> peak_live_bytes = 0;
+    };
+
+    inline constinit allocation_counters counters;
+
+    // every block is preceded by the pointer malloc returned for it and its size, so that delete knows what it frees
+    struct block_header {
+        void* raw = nullptr;
+        size_t size = 0;
+    };
+
+    inline void* allocate(const size_t size, size_t alignment) noexcept
+    {
+        alignment = std::max(alignment, alignof(std::max_align_t));
+
+        void* const raw = std::malloc(size + sizeof(block_header) + alignment);
+        if (!raw)
+            return nullptr;
+
+        const auto address = (reinterpret_cast<uintptr_t>(raw) + sizeof(block_header) + alignment - 1) & ~(uintptr_t { alignment } - 1);
+        new (reinterpret_cast<void*>(address - sizeof(block_header))) block_header { .raw = raw, .size = size };
+
+        counters.num_allocations.fetch_add(1, std::memory_order_relaxed);
+        counters.num_bytes.fetch_add(size, std::memory_order_relaxed);
+
+        const auto live = counters.live_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+        auto peak = counters.peak_live_bytes.load(std::memory_order_relaxed);
+        while (live > peak && !counters.peak_live_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) { }
+
+        return reinterpret_cast<void*>(address);
+    }
+
+    inline void* allocate_or_throw(const size_t size, const size_t alignment)
+    {
+        for (;;) {
+            if (void* const p = allocate(size, alignment))
+                return p;
+
+            if (const auto handler = std::get_new_handler())
+                handler();
+            else
+                throw std::bad_alloc();
+        }
+    }
+
+    inline void deallocate(void* const p) noexcept
+    {
+        if (!p)
+            return;
+
+        const auto header = *reinterpret_cast<const block_header*>(static_cast<std::byte*>(p) - sizeof(block_header));
+        counters.live_bytes.fetch_sub(header.size, std::memory_order_relaxed);
+        std::free(header.raw);
+    }
+
+    inline std::mutex allocation_phases_mutex;
+    inline std::vector<allocation_stats> allocation_phases;
+}
+
+namespace detail {
+    // name of the innermost phase of the calling thread, the prefix of the names of the phases nested in it
+    inline thread_local std::string current_allocation_phase;
+}
+
+// counts the allocations made (by any thread) during its lifetime and records them under the given name (prefixed by
+// the names of the phases it is nested in, e.g. "part 1 / parse") when destroyed; the peak live bytes of a phase include
+// the bytes live when it began. phases of the same name are accumulated into a single record (their counts summed, the
+// largest peak kept), so that a phase may be entered once per line or batch of a streamed input
+class allocation_phase {
+public:
+    explicit allocation_phase(const std::string_view name)
+        : outer_name_(detail::current_allocation_phase)
+        , name_(outer_name_.empty() ? std::string { name } : outer_name_ + " / " + std::string { name })
+    {
+        detail::current_allocation_phase = name_;
+
+        // the bookkeeping above isn't counted towards the phase
+        num_allocations_ = detail::counters.num_allocations.load();
+        num_bytes_ = detail::counters.num_bytes.load();
+        outer_peak_live_bytes_ = detail::counters.peak_live_bytes.exchange(detail::counters.live_bytes.load());
+    }
+
+    allocation_phase(const allocation_phase&) = delete;
+    allocation_phase& operator=(const allocation_phase&) = delete;
+
+    ~allocation_phase()
+    {
+        detail::current_allocation_phase = outer_name_;
+
+        allocation_stats stats { .name = std::move(name_),
+            .num_allocations = detail::counters.num_allocations.load() - num_allocations_,
+            .num_bytes = detail::counters.num_bytes.load() - num_bytes_,
+            .peak_live_bytes = detail::counters.peak_live_bytes.load() };
+
+        // the enclosing phase keeps its own peak
+        auto peak = detail::counters.peak_live_bytes.load();
+        while (outer_peak_live_bytes_ > peak && !detail::counters.peak_live_bytes.compare_exchange_weak(peak, outer_peak_live_bytes_)) { }
+
+        const std::scoped_lock lock(detail::allocation_phases_mutex);
+
+        const auto it = std::ranges::find(detail::allocation_phases, stats.name, &allocation_stats::name);
+        if (it == detail::allocation_phases.end()) {
+            detail::allocation_phases.push_back(std::move(stats));
+            return;
+        }
+
+        it->num_allocations += stats.num_allocations;
+        it->num_bytes += stats.num_bytes;
+        it->peak_live_bytes = std::max(it->peak_live_bytes, stats.peak_live_bytes);
+    }
+
+private:
+    std::string outer_name_;
+    std::string name_;
+    size_t num_allocations_ = 0;
+    size_t num_bytes_ = 0;
+    size_t outer_peak_live_bytes_ = 0;
+};
+
+// prints the phases recorded so far and the peak resident set size of the process
+inline void report_allocation_stats(std::ostream& out)
+{
+    const std::scoped_lock lock(detail::allocation_phases_mutex);
+
+    for (const auto& phase : detail::allocation_phases)
+        out << "allocations [" << phase.name << "]: " << phase.num_allocations << " (" << phase.num_bytes << " bytes), peak " << phase.peak_live_bytes
+            << " live bytes\n";
+
+    if (const auto rss = peak_resident_set_size())
+        out << "peak rss: " << *rss / 1024 << " KiB\n";
+}
+
+#else
+
+class allocation_phase {
+public:
+    explicit allocation_phase(const std::string_view) { }
+};
+
+inline void report_allocation_stats(std::ostream&) { }
+
+#endif
+
+}
+
+#if QUXFLUX_ALLOCATION_STATS
+
+void* operator new(const std::size_t size) { return quxflux::detail::allocate_or_throw(size, alignof(std::max_align_t)); }
+void* operator new[](const std::size_t size) { return quxflux::detail::allocate_or_throw(size, alignof(std::max_align_t)); }
+void* operator new(const std::size_t size, const std::align_val_t alignment) { return quxflux::detail::allocate_or_throw(size, static_cast<std::size_t>(alignment)); }
+void* operator new[](const std::size_t size, const std::align_val_t alignment) { return quxflux::detail::allocate_or_throw(size, static_cast<std::size_t>(alignment)); }
+
+void* operator new(const std::size_t size, const std::nothrow_t&) noexcept { return quxflux::detail::allocate(size, alignof(std::max_align_t)); }
+void* operator new[](const std::size_t size, const std::nothrow_t&) noexcept { return quxflux::detail::allocate(size, alignof(std::max_align_t)); }
+void* operator new(const std::size_t size, const std::align_val_t alignment, const std::nothrow_t&) noexcept { return quxflux::detail::allocate(size, static_cast<std::size_t>(alignment)); }
+void* operator new[](const std::size_t size, const std::align_val_t alignment, const std::nothrow_t&) noexcept { return quxflux::detail::allocate(size, static_cast<std::size_t>(alignment)); }
+
+void operator delete(void* const p) noexcept { quxflux::detail::deallocate(p); }
+void operator delete[](void* const p) noexcept { quxflux::detail::deallocate(p); }
+void operator delete(void* const p, std::size_t) noexcept { quxflux::detail::deallocate(p); }
+void operator delete[](void* const p, std::size_t) noexcept { quxflux::detail::deallocate(p); }
+void operator delete(void* const p, std::align_val_t) noexcept { quxflux::detail::deallocate(p); }
+void operator delete[](void* const p, std::align_val_t) noexcept { quxflux::detail::deallocate(p); }
+void operator delete(void* const p, std::size_t, std::align_val_t) noexcept { quxflux::detail::deallocate(p); }
+void operator delete[](void* const p, std::size_t, std::align_val_t) noexcept { quxflux::detail::deallocate(p); }
+void operator delete(void* const p, const std::nothrow_t&) noexcept { quxflux::detail::deallocate(p); }
+void operator delete[](void* const p, const std::nothrow_t&) noexcept { quxflux::detail::deallocate(p); }
+void operator delete(void* const p, std::align_val_t, const std::nothrow_t&) noexcept { quxflux::detail::deallocate(p); }
+void operator delete[](void* const p, std::align_val_t, const std::nothrow_t&) noexcept { quxflux::detail::deallocate(p); }
+
+#endif
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <aoc23/perf_counters.h>
+
+#include <chrono>
+#include <cstddef>
+#include <iomanip>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace quxflux {
+
+// wall time and hardware counters (see perf_counters) of the phases of a day, measured if enabled (--bench)
+class benchmark {
+public:
+    struct phase_result {
+        std::string name;
+        std::chrono::steady_clock::duration duration {};
+        perf_counters::counts counts;
+    };
+
+    // measures from construction to destruction
+    class phase {
+    public:
+        phase(benchmark& b, std::string name)
+            : benchmark_(b.counters_ ? &b : nullptr)
+            , name_(std::move(name))
+        {
+            if (!benchmark_)
+                return;
+
+            begin_reading_ = benchmark_->counters_->read();
+            begin_ = std::chrono::steady_clock::now();
+        }
+
+        phase(const phase&) = delete;
+        phase& operator=(const phase&) = delete;
+
+        ~phase()
+        {
+            if (!benchmark_)
+                return;
+
+            const auto end = std::chrono::steady_clock::now();
+            const auto end_reading = benchmark_->counters_->read();
+
+            benchmark_->phases_.push_back({ .name = std::move(name_), .duration = end - begin_, .counts = perf_counters::between(begin_reading_, end_reading) });
+        }
+
+    private:
+        benchmark* benchmark_;
+        std::string name_;
+        perf_counters::reading begin_reading_;
+        std::chrono::steady_clock::time_point begin_;
+    };
+
+    explicit benchmark(const bool enabled)
+    {
+        if (enabled)
+            counters_.emplace();
+    }
+
+    [[nodiscard]] phase measure(std::string name) { return phase(*this, std::move(name)); }
+
+    // one line per phase: its wall time, cycles and IPC and the cache and branch misses per byte of the input
+    void report(std::ostream& out, const size_t input_size) const
+    {
+        if (!counters_)
+            return;
+
+        const auto count = [](const phase_result& r, const hardware_event e) { return r.counts[static_cast<size_t>(e)]; };
+
+        for (const auto& r : phases_) {
+            out << r.name << ": " << std::fixed << std::setprecision(3) << std::chrono::duration<double, std::milli>(r.duration).count() << " ms";
+
+            bool any_counted = false;
+
+            if (const auto cycles = count(r, hardware_event::cycles)) {
+                out << ", " << std::setprecision(0) << *cycles << " cycles";
+                any_counted = true;
+
+                if (const auto instructions = count(r, hardware_event::instructions); instructions && *cycles > 0)
+                    out << ", " << std::setprecision(2) << *instructions / *cycles << " IPC";
+            }
+
+            for (const auto e : { hardware_event::l1d_read_misses, hardware_event::llc_read_misses, hardware_event::branch_misses }) {
+                if (const auto misses = count(r, e); misses && input_size > 0) {
+                    out << ", " << std::setprecision(4) << *misses / static_cast<double>(input_size) << ' ' << hardware_event_names[static_cast<size_t>(e)] << "/byte";
+                    any_counted = true;
+                }
+            }
+
+            // the counters miss the work the parallel algorithms hand to other threads (see perf_counters)
+            if (any_counted)
+                out << " (calling thread only)";
+
+            out << '\n';
+        }
+
+        out << std::defaultfloat;
+
+        if (!counters_->unavailable_reason().empty())
+            out << (counters_->any_available() ? "some hardware counters" : "hardware counters") << " unavailable (" << counters_->unavailable_reason() << ")\n";
+    }
+
+private:
+    std::optional<perf_counters> counters_;
+    std::vector<phase_result> phases_;
+};
+
+}
@@ -0,0 +1,726 @@
+#pragma once
+
+#include <aoc23/allocation_stats.h>
+#include <aoc23/benchmark.h>
+#include <aoc23/result_cache.h>
+#include <aoc23/snapshot.h>
+#include <aoc23/util.h>
+
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define QUXFLUX_HAS_UNIX_SOCKETS 1
+#endif
+
+// identifies the solver in the keys of the result cache, defined by the build as hash of the day's sources; a build
+// without it can't tell its answers from those of other code and refuses to use a result cache
+#ifndef QUXFLUX_SOLVER_VERSION
+#define QUXFLUX_SOLVER_VERSION ""
+#endif
+
+namespace quxflux {
+
+// a day's puzzle; its parts solve the current input (see QUXFLUX_GET_INPUT) and return the formatted answer
+struct puzzle {
+    unsigned day = 0;
+    std::array<std::function<std::string()>, 2> parts;
+    std::string_view solver_version = QUXFLUX_SOLVER_VERSION;
+    std::optional<result_cache> cache;
+
+    // looks the answer up in the cache (if any) before solving the part
+    std::string solve(const size_t part, const std::string_view input) const
+    {
+        if (part < 1 || part > parts.size())
+            throw std::invalid_argument("no such part");
+
+        const auto solve_uncached = [&] {
+            const scoped_input scope(input);
+            return parts[part - 1]();
+        };
+
+        if (!cache)
+            return solve_uncached();
+
+        const result_cache::key key { .day = day, .part = part, .solver_version = solver_version, .input_hash = xxh64(input) };
+
+        if (auto answer = cache->find(key))
+            return *std::move(answer);
+
+        auto answer = solve_uncached();
+        cache->store(key, answer);
+        return answer;
+    }
+};
+
+namespace detail {
+    template <typename F>
+    std::function<std::string()> formatted(F part)
+    {
+        return [part] {
+            std::ostringstream oss;
+            oss << part();
+            return oss.str();
+        };
+    }
+
+    // contents of the input files read so far, reread once a file changes
+    class input_file_cache {
+    public:
+        std::shared_ptr<const std::string> get(const std::filesystem::path& path)
+        {
+            const auto last_write_time = std::filesystem::last_write_time(path);
+            const auto size = std::filesystem::file_size(path);
+
+            const std::scoped_lock lock(mutex_);
+
+            auto& entry = entries_[path];
+            if (!entry.contents || entry.last_write_time != last_write_time || entry.size != size)
+                entry = { .last_write_time = last_write_time, .size = size, .contents = std::make_shared<const std::string>(read_file(path)) };
+
+            return entry.contents;
+        }
+
+    private:
+        struct entry {
+            std::filesystem::file_time_type last_write_time;
+            std::uintmax_t size = 0;
+            std::shared_ptr<const std::string> contents;
+        };
+
+        std::mutex mutex_;
+        std::map<std::filesystem::path, entry> entries_;
+    };
+
+#if QUXFLUX_HAS_UNIX_SOCKETS
+    class unique_fd {
+    public:
+        explicit unique_fd(const int fd)
+            : fd_(fd)
+        {
+            if (fd_ < 0)
+                throw std::system_error(errno, std::generic_category());
+        }
+
+        unique_fd(const unique_fd&) = delete;
+        unique_fd& operator=(const unique_fd&) = delete;
+
+        ~unique_fd() { ::close(fd_); }
+
+        [[nodiscard]] int get() const { return fd_; }
+
+    private:
+        int fd_;
+    };
+
+    inline unique_fd make_unix_socket()
+    {
+        const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+            throw std::system_error(errno, std::generic_category(), "socket");
+
+        return unique_fd(fd);
+    }
+
+    struct connection_lost : std::runtime_error {
+        using std::runtime_error::runtime_error;
+    };
+
+    // a request which can't be answered without losing track of where the client's next request starts; the client is
+    // told so and the connection is closed
+    struct protocol_error : std::runtime_error {
+        using std::runtime_error::runtime_error;
+    };
+
+    // limits protecting the daemon from allocating whatever a client declares or sends
+    constexpr size_t max_request_line_size = 4096;
+    constexpr size_t max_payload_size = size_t { 1 } << 30;
+
+    // buffered reads of lines and byte counts from a socket
+    class socket_reader {
+    public:
+        explicit socket_reader(const int fd)
+            : fd_(fd)
+        {
+        }
+
+        // the next line without its line break, std::nullopt once the peer closed the connection
+        std::optional<std::string> read_line()
+        {
+            size_t scanned = 0;
+
+            for (;;) {
+                if (const auto line_break = buffer_.find('\n', scanned); line_break != std::string::npos) {
+                    std::string line = buffer_.substr(0, line_break);
+                    buffer_.erase(0, line_break + 1);
+                    return line;
+                }
+
+                scanned = buffer_.size();
+
+                if (scanned > max_request_line_size)
+                    throw protocol_error("request line too long");
+
+                if (!fill())
+                    return std::nullopt;
+            }
+        }
+
+        std::string read_exactly(const size_t num_bytes)
+        {
+            while (buffer_.size() < num_bytes)
+                if (!fill())
+                    throw connection_lost("connection closed before the end of the payload");
+
+            std::string bytes = buffer_.substr(0, num_bytes);
+            buffer_.erase(0, num_bytes);
+            return bytes;
+        }
+
+    private:
+        bool fill()
+        {
+            std::array<char, 1 << 16> chunk;
+
+            for (;;) {
+                const auto n = ::recv(fd_, chunk.data(), chunk.size(), 0);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n < 0)
+                    throw connection_lost(std::system_category().message(errno));
+                if (n == 0)
+                    return false;
+
+                buffer_.append(chunk.data(), static_cast<size_t>(n));
+                return true;
+            }
+        }
+
+        int fd_;
+        std::string buffer_;
+    };
+
+    inline void send_all(const int fd, std::string_view data)
+    {
+        while (!data.empty()) {
+            const auto n = ::send(fd, data.data(), data.size(), 0);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0)
+                throw std::system_error(errno, std::generic_category(), "send");
+
+            data.remove_prefix(static_cast<size_t>(n));
+        }
+    }
+
+    // answers a single request, either
+    //   <day> <part> path <input path>
+    //   <day> <part> inline <number of bytes>
+    // the latter followed by the input itself
+    inline std::string answer(const puzzle& p, input_file_cache& input_files, socket_reader& reader, std::string_view request)
+    {
+        const auto day = consume_uint(request);
+        const auto part = consume_uint(request);
+
+        if (!day || !part)
+            throw std::invalid_argument("malformed request");
+
+        const auto first_non_blank = request.find_first_not_of(' ');
+        request.remove_prefix(first_non_blank == std::string_view::npos ? request.size() : first_non_blank);
+
+        constexpr std::string_view inline_prefix = "inline ";
+        constexpr std::string_view path_prefix = "path ";
+
+        // an inline payload is read before validating the request any further to stay in sync with the client
+        std::optional<std::string> payload;
+
+        if (request.starts_with(inline_prefix)) {
+            request.remove_prefix(inline_prefix.size());
+            const auto num_bytes = consume_uint(request);
+            if (!num_bytes)
+                throw std::invalid_argument("malformed request");
+
+            if (*num_bytes > max_payload_size)
+                throw protocol_error("payload larger than " + std::to_string(max_payload_size) + " bytes");
+
+            payload = reader.read_exactly(*num_bytes);
+        } else if (request.starts_with(path_prefix)) {
+            request.remove_prefix(path_prefix.size());
+        } else {
+            throw std::invalid_argument("malformed request");
+        }
+
+        if (*day != p.day)
+            throw std::invalid_argument("this daemon solves day " + std::to_string(p.day));
+
+        if (payload)
+            return p.solve(*part, *payload);
+
+        const auto input = input_files.get(request);
+        return p.solve(*part, *input);
+    }
+
+    inline void serve_connection(const puzzle& p, input_file_cache& input_files, const unique_fd& connection)
+    {
+        socket_reader reader(connection.get());
+
+        for (;;) {
+            std::string response;
+
+            try {
+                const auto request = reader.read_line();
+                if (!request)
+                    return;
+
+                response = answer(p, input_files, reader, *request) + '\n';
+            } catch (const connection_lost&) {
+                return;
+            } catch (const protocol_error& e) {
+                send_all(connection.get(), std::string { "error " } + e.what() + '\n');
+                return;
+            } catch (const std::exception& e) {
+                response = std::string { "error " } + e.what() + '\n';
+            }
+
+            send_all(connection.get(), response);
+        }
+    }
+#endif
+}
+
+namespace detail {
+    // fifo of limited capacity between threads: push blocks while the queue is full, pop while it is empty and not closed
+    template <typename T>
+    class bounded_queue {
+    public:
+        explicit bounded_queue(const size_t capacity)
+            : capacity_(std::max(capacity, size_t { 1 }))
+        {
+        }
+
+        void push(T value)
+        {
+            std::unique_lock lock(mutex_);
+            not_full_.wait(lock, [&] { return items_.size() < capacity_; });
+            items_.push_back(std::move(value));
+            not_empty_.notify_one();
+        }
+
+        void close()
+        {
+            const std::scoped_lock lock(mutex_);
+            closed_ = true;
+            not_empty_.notify_all();
+        }
+
+        // the next item, std::nullopt once the queue is closed and drained
+        std::optional<T> pop()
+        {
+            std::unique_lock lock(mutex_);
+            not_empty_.wait(lock, [&] { return !items_.empty() || closed_; });
+
+            if (items_.empty())
+                return std::nullopt;
+
+            T value = std::move(items_.front());
+            items_.pop_front();
+            not_full_.notify_one();
+            return value;
+        }
+
+    private:
+        size_t capacity_;
+        std::mutex mutex_;
+        std::condition_variable not_full_;
+        std::condition_variable not_empty_;
+        std::deque<T> items_;
+        bool closed_ = false;
+    };
+
+    inline std::string json_string(const std::string_view str)
+    {
+        std::ostringstream oss;
+        oss << '"';
+
+        for (const char c : str) {
+            if (c == '"' || c == '\\')
+                oss << '\\' << c;
+            else if (static_cast<unsigned char>(c) < 0x20)
+                oss << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec;
+            else
+                oss << c;
+        }
+
+        oss << '"';
+        return oss.str();
+    }
+
+    // the given files along with the regular files of the given directories (in the order of their names); throws
+    // std::filesystem::filesystem_error for a path which doesn't exist or can't be listed
+    inline std::vector<std::filesystem::path> expand_directories(const std::span<const std::filesystem::path> paths)
+    {
+        std::vector<std::filesystem::path> files;
+
+        for (const auto& path : paths) {
+            if (!std::filesystem::exists(path))
+                throw std::filesystem::filesystem_error("no such input", path, std::make_error_code(std::errc::no_such_file_or_directory));
+
+            if (!std::filesystem::is_directory(path)) {
+                files.push_back(path);
+                continue;
+            }
+
+            const auto first = files.size();
+
+            for (const auto& entry : std::filesystem::directory_iterator(path))
+                if (entry.is_regular_file())
+                    files.push_back(entry.path());
+
+            std::sort(files.begin() + static_cast<ptrdiff_t>(first), files.end());
+        }
+
+        return files;
+    }
+}
+
+#if QUXFLUX_HAS_UNIX_SOCKETS
+// daemon mode: listens on a unix domain socket and answers the requests of up to num_connection_threads connections at
+// a time (see detail::answer), further connections waiting to be accepted until a thread is free. the process stays
+// warm between requests: its thread pools, the input files read before and the models of the days loading theirs
+// through load_model (see warm_models)
+[[noreturn]] inline void serve(const puzzle& p, const std::filesystem::path& socket_path, const size_t num_connection_threads)
+{
+    constexpr size_t max_num_warm_models = 16;
+
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+
+    const auto native_path = socket_path.native();
+    if (native_path.size() >= sizeof(address.sun_path))
+        throw std::invalid_argument("socket path too long");
+
+    std::ranges::copy(native_path, address.sun_path);
+
+    // a socket left behind by a previous daemon would make bind fail, one still accepting connections belongs to a
+    // running daemon though
+    if (std::filesystem::is_socket(socket_path)) {
+        const auto probe = detail::make_unix_socket();
+
+        if (::connect(probe.get(), reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0)
+            throw std::runtime_error("a daemon is already listening on " + socket_path.string());
+
+        if (errno != ECONNREFUSED)
+            throw std::system_error(errno, std::generic_category(), "connect");
+
+        std::filesystem::remove(socket_path);
+    }
+
+    const auto listener = detail::make_unix_socket();
+
+    if (::bind(listener.get(), reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+        throw std::system_error(errno, std::generic_category(), "bind");
+
+    if (::listen(listener.get(), SOMAXCONN) != 0)
+        throw std::system_error(errno, std::generic_category(), "listen");
+
+    // a client disconnecting early must not terminate the daemon
+    std::signal(SIGPIPE, SIG_IGN);
+
+    warm_models.emplace(max_num_warm_models);
+
+    detail::input_file_cache input_files;
+    detail::bounded_queue<int> connections(num_connection_threads);
+
+    std::vector<std::jthread> connection_threads;
+
+    // the queue is closed on any error (starting a thread included) before the threads are joined, the connections
+    // accepted so far still being served
+    try {
+        for (size_t i = 0; i < std::max(num_connection_threads, size_t { 1 }); ++i) {
+            connection_threads.emplace_back([&] {
+                while (const auto connection = connections.pop()) {
+                    try {
+                        const detail::unique_fd fd(*connection);
+                        detail::serve_connection(p, input_files, fd);
+                    } catch (const std::exception& e) {
+                        std::cerr << "connection failed: " << e.what() << '\n';
+                    }
+                }
+            });
+        }
+
+        for (;;) {
+            const int connection = ::accept(listener.get(), nullptr, nullptr);
+
+            if (connection < 0) {
+                if (errno == EINTR || errno == ECONNABORTED)
+                    continue;
+
+                throw std::system_error(errno, std::generic_category(), "accept");
+            }
+
+            connections.push(connection);
+        }
+    } catch (...) {
+        connections.close();
+        throw;
+    }
+}
+#endif
+
+// batch mode: solves both parts of every input, a read ahead thread loading the inputs into a bounded queue while
+// num_workers threads take them from there, so that reading overlaps with solving; prints one json object per input
+// (in the order of completion) and returns the number of inputs which failed
+inline size_t solve_batch(const puzzle& p, const std::span<const std::filesystem::path> paths, const size_t num_workers, std::ostream& out)
+{
+    struct loaded_input {
+        std::filesystem::path path;
+        std::string contents;
+        bool readable = false;
+    };
+
+    detail::bounded_queue<loaded_input> inputs(2 * num_workers);
+
+    std::jthread reader([&] {
+        for (const auto& path : paths) {
+            std::ifstream file(path, std::ios::binary);
+            loaded_input input { .path = path, .contents = {}, .readable = static_cast<bool>(file) };
+
+            if (input.readable)
+                input.contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+            inputs.push(std::move(input));
+        }
+
+        inputs.close();
+    });
+
+    std::mutex out_mutex;
+    std::atomic<size_t> num_failed = 0;
+
+    {
+        std::vector<std::jthread> workers;
+
+        for (size_t i = 0; i < std::max(num_workers, size_t { 1 }); ++i) {
+            workers.emplace_back([&] {
+                while (const auto input = inputs.pop()) {
+                    std::string line = "{\"input\":" + detail::json_string(input->path.string());
+
+                    try {
+                        if (!input->readable)
+                            throw std::runtime_error("unable to read input");
+
+                        const auto part_1 = p.solve(1, input->contents);
+                        const auto part_2 = p.solve(2, input->contents);
+                        line += ",\"part_1\":" + detail::json_string(part_1) + ",\"part_2\":" + detail::json_string(part_2);
+                    } catch (const std::exception& e) {
+                        line += ",\"error\":" + detail::json_string(e.what());
+                        ++num_failed;
+                    }
+
+                    line += "}\n";
+
+                    const std::scoped_lock lock(out_mutex);
+                    out << line << std::flush;
+                }
+            });
+        }
+    }
+
+    return num_failed;
+}
+
+namespace detail {
+    struct driver_options {
+        std::optional<std::filesystem::path> socket_path;
+        std::optional<std::filesystem::path> cache_directory;
+        std::optional<std::filesystem::path> snapshot_directory;
+        std::vector<std::filesystem::path> batch_paths;
+        std::optional<size_t> stream_part;
+        bool bench = false;
+        size_t num_jobs = std::max(size_t { std::thread::hardware_concurrency() }, size_t { 1 });
+    };
+
+    inline std::optional<driver_options> parse_options(const std::span<const char* const> args)
+    {
+        driver_options options;
+
+        for (size_t i = 0; i < args.size(); ++i) {
+            const std::string_view arg = args[i];
+
+            if (arg == "--bench") {
+                options.bench = true;
+                continue;
+            }
+
+            if (i + 1 == args.size())
+                return std::nullopt;
+
+            if (arg == "--serve")
+                options.socket_path = args[++i];
+            else if (arg == "--cache")
+                options.cache_directory = args[++i];
+            else if (arg == "--snapshots")
+                options.snapshot_directory = args[++i];
+            else if (arg == "--batch")
+                options.batch_paths.emplace_back(args[++i]);
+            else if (arg == "--jobs") {
+                std::string_view jobs = args[++i];
+                const auto num_jobs = consume_uint(jobs);
+                if (!num_jobs || *num_jobs == 0 || !jobs.empty())
+                    return std::nullopt;
+
+                options.num_jobs = *num_jobs;
+            } else if (arg == "--stream") {
+                std::string_view part = args[++i];
+                const auto stream_part = consume_uint(part);
+                if (!stream_part || *stream_part < 1 || *stream_part > 2 || !part.empty())
+                    return std::nullopt;
+
+                options.stream_part = *stream_part;
+            } else
+                return std::nullopt;
+        }
+
+        if ((options.socket_path.has_value() + !options.batch_paths.empty() + options.stream_part.has_value() + options.bench) > 1)
+            return std::nullopt;
+
+        // a benchmark would time the cache lookup instead of the parts
+        if (options.bench && options.cache_directory)
+            return std::nullopt;
+
+        return options;
+    }
+}
+
+// entry point of every day: prints the answers of both parts for the day's input (see QUXFLUX_INPUT_PATH) or, given
+// --serve <socket path>, runs as daemon on --jobs <n> connection threads (see serve); --cache <directory> looks the
+// answers up in a result_cache first, --snapshots <directory> lets the days supporting it keep snapshots of their
+// parsed models there; --batch <file or directory> (repeatable) solves the given inputs instead on --jobs <n> threads
+// (see solve_batch); --stream <part> solves the part for the input read from stdin, which the days reading their input
+// through QUXFLUX_GET_INPUT_LINES consume line by line (a stream can be read only once and isn't hashed, hence the
+// single part and no cache; day 7 prints its running total after every hand before the answer). builds with allocation
+// stats (see allocation_stats.h) report the allocations of every phase on stderr and refuse --serve and --batch,
+// --bench reports the wall time and hardware counters of every phase there (see benchmark) and can't be combined with
+// --cache
+template <typename Part1, typename Part2>
+int run_puzzle(const unsigned day, Part1 part_1, Part2 part_2, const std::filesystem::path& input_path, const int argc, const char* const argv[])
+{
+    const auto options = detail::parse_options(std::span(argv + 1, static_cast<size_t>(std::max(argc - 1, 0))));
+
+    if (!options) {
+        std::cerr << "usage: " << argv[0] << " [--cache <directory>] [--snapshots <directory>] [--jobs <n>] [--serve <socket path> | --batch <path>... | --stream <part> | --bench]\n";
+        return 1;
+    }
+
+#if QUXFLUX_ALLOCATION_STATS
+    // the allocation counters are global, they would mix up the phases of inputs solved concurrently
+    if (options->socket_path || !options->batch_paths.empty()) {
+        std::cerr << "--serve and --batch are unavailable in builds with allocation stats\n";
+        return 1;
+    }
+#endif
+
+    puzzle p { .day = day, .parts = { detail::formatted(part_1), detail::formatted(part_2) }, .solver_version = QUXFLUX_SOLVER_VERSION, .cache = std::nullopt };
+
+    if (options->cache_directory) {
+        if (p.solver_version.empty()) {
+            std::cerr << "--cache requires a build defining QUXFLUX_SOLVER_VERSION\n";
+            return 1;
+        }
+
+        p.cache.emplace(*options->cache_directory);
+    }
+
+    snapshot_directory = options->snapshot_directory;
+
+    if (options->socket_path) {
+#if QUXFLUX_HAS_UNIX_SOCKETS
+        try {
+            serve(p, *options->socket_path, options->num_jobs);
+        } catch (const std::exception& e) {
+            std::cerr << "unable to serve: " << e.what() << '\n';
+            return 1;
+        }
+#else
+        std::cerr << "daemon mode requires unix domain sockets\n";
+        return 1;
+#endif
+    }
+
+    if (!options->batch_paths.empty()) {
+        std::vector<std::filesystem::path> inputs;
+
+        try {
+            inputs = detail::expand_directories(options->batch_paths);
+        } catch (const std::filesystem::filesystem_error& e) {
+            std::cerr << "invalid --batch path: " << e.what() << '\n';
+            return 1;
+        }
+
+        return solve_batch(p, inputs, options->num_jobs, std::cout) == 0 ? 0 : 1;
+    }
+
+    if (options->stream_part) {
+        input_fd = 0;
+
+        {
+            const allocation_phase phase("part " + std::to_string(*options->stream_part));
+            std::cout << p.parts.at(*options->stream_part - 1)() << '\n';
+        }
+
+        report_allocation_stats(std::cerr);
+        return 0;
+    }
+
+    benchmark bench(options->bench);
+
+    const auto input = [&] {
+        const allocation_phase phase("read input");
+        const auto timing = bench.measure("read input");
+        return read_file(input_path);
+    }();
+
+    for (const size_t part : { 1, 2 }) {
+        const auto name = "part " + std::to_string(part);
+        const allocation_phase phase(name);
+
+        std::string answer;
+        {
+            const auto timing = bench.measure(name);
+            answer = p.solve(part, input);
+        }
+
+        std::cout << answer << '\n';
+    }
+
+    report_allocation_stats(std::cerr);
+    bench.report(std::cerr, input.size());
+    return 0;
+}
+
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+namespace quxflux {
+
+// binary indexed tree over n values, all initially zero; adding to a value and summing a prefix of the values take
+// O(log n) each
+template <typename T>
+class fenwick_tree {
+public:
+    explicit fenwick_tree(const size_t size)
+        : tree_(size + 1)
+    {
+    }
+
+    [[nodiscard]] size_t size() const { return tree_.size() - 1; }
+
+    void add(const size_t idx, const T& delta)
+    {
+        if (idx >= size())
+            throw std::out_of_range("fenwick tree index out of range");
+
+        for (size_t i = idx + 1; i < tree_.size(); i += i & (~i + 1))
+            tree_[i] += delta;
+    }
+
+    // sum of the values [0, end)
+    [[nodiscard]] T prefix_sum(const size_t end) const
+    {
+        if (end > size())
+            throw std::out_of_range("fenwick tree index out of range");
+
+        T sum {};
+        for (size_t i = end; i > 0; i -= i & (~i + 1))
+            sum += tree_[i];
+
+        return sum;
+    }
+
+private:
+    std::vector<T> tree_;
+};
+
+}
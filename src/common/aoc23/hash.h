@@ -0,0 +1,87 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+namespace quxflux {
+
+namespace detail {
+    template <typename T>
+    T read_little_endian(const char* data)
+    {
+        T value;
+        std::memcpy(&value, data, sizeof(T));
+
+        if constexpr (std::endian::native == std::endian::big)
+            value = std::byteswap(value);
+
+        return value;
+    }
+}
+
+// XXH64 of data; its four independent accumulator lanes consume 32 bytes per round without depending on each other
+inline uint64_t xxh64(const std::string_view data, const uint64_t seed = 0)
+{
+    constexpr uint64_t prime_1 = 0x9e3779b185ebca87;
+    constexpr uint64_t prime_2 = 0xc2b2ae3d27d4eb4f;
+    constexpr uint64_t prime_3 = 0x165667b19e3779f9;
+    constexpr uint64_t prime_4 = 0x85ebca77c2b2ae63;
+    constexpr uint64_t prime_5 = 0x27d4eb2f165667c5;
+
+    using detail::read_little_endian;
+
+    constexpr auto round = [](const uint64_t acc, const uint64_t input) { return std::rotl(acc + input * prime_2, 31) * prime_1; };
+    constexpr auto merge_round = [=](const uint64_t acc, const uint64_t lane) { return (acc ^ round(0, lane)) * prime_1 + prime_4; };
+
+    const char* p = data.data();
+    const char* const end = p + data.size();
+
+    uint64_t h;
+
+    if (data.size() >= 32) {
+        uint64_t lanes[4] = { seed + prime_1 + prime_2, seed + prime_2, seed, seed - prime_1 };
+
+        for (; end - p >= 32; p += 32)
+            for (size_t i = 0; i < 4; ++i)
+                lanes[i] = round(lanes[i], read_little_endian<uint64_t>(p + i * 8));
+
+        h = std::rotl(lanes[0], 1) + std::rotl(lanes[1], 7) + std::rotl(lanes[2], 12) + std::rotl(lanes[3], 18);
+
+        for (const auto lane : lanes)
+            h = merge_round(h, lane);
+    } else {
+        h = seed + prime_5;
+    }
+
+    h += data.size();
+
+    for (; end - p >= 8; p += 8)
+        h = std::rotl(h ^ round(0, read_little_endian<uint64_t>(p)), 27) * prime_1 + prime_4;
+
+    if (end - p >= 4) {
+        h = std::rotl(h ^ (read_little_endian<uint32_t>(p) * prime_1), 23) * prime_2 + prime_3;
+        p += 4;
+    }
+
+    for (; p != end; ++p)
+        h = std::rotl(h ^ (static_cast<uint8_t>(*p) * prime_5), 11) * prime_1;
+
+    h = (h ^ (h >> 33)) * prime_2;
+    h = (h ^ (h >> 29)) * prime_3;
+    return h ^ (h >> 32);
+}
+
+// the 16 hexadecimal digits of a hash
+inline std::string to_hex(const uint64_t hash)
+{
+    std::ostringstream oss;
+    oss << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return oss.str();
+}
+
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <aoc23/util.h>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace quxflux {
+
+// the lines of an input (without their line breaks) as input range, taken either from memory or read incrementally
+// from a file descriptor through two fixed size buffers: the unfinished line at the end of one buffer is moved to the
+// front of the other one before reading on, so inputs of any size are consumed in constant memory. a line is valid
+// until the next one is read; lines longer than a buffer are rejected. unlike split('\n'), no empty line follows a
+// line break ending the input (which e.g. day 1 counted as 0 before)
+class line_source {
+public:
+    static constexpr size_t default_buffer_size = 1 << 16;
+
+    explicit line_source(const std::string_view text)
+        : text_(text)
+    {
+    }
+
+    explicit line_source(const int fd, const size_t buffer_size = default_buffer_size)
+        : fd_(fd)
+        , buffers_ { std::vector<char>(buffer_size), std::vector<char>(buffer_size) }
+    {
+        if (buffer_size == 0)
+            throw std::invalid_argument("line buffer must not be empty");
+    }
+
+    // the next line, std::nullopt past the last one
+    std::optional<std::string_view> next()
+    {
+        if (!fd_) {
+            if (text_.empty())
+                return std::nullopt;
+
+            const auto end_of_line = std::min(text_.find('\n'), text_.size());
+            const auto line = text_.substr(0, end_of_line);
+            text_.remove_prefix(std::min(end_of_line + 1, text_.size()));
+
+            return line;
+        }
+
+        for (;;) {
+            const auto* const data = buffers_[current_].data();
+
+            if (const auto* const end_of_line = std::find(data + begin_, data + end_, '\n'); end_of_line != data + end_) {
+                const std::string_view line(data + begin_, end_of_line);
+                begin_ = static_cast<size_t>(end_of_line - data) + 1;
+                return line;
+            }
+
+            if (at_end_) {
+                if (begin_ == end_)
+                    return std::nullopt;
+
+                return std::string_view(data + std::exchange(begin_, end_), data + end_);
+            }
+
+            auto& other = buffers_[1 - current_];
+            const size_t unfinished = end_ - begin_;
+
+            if (unfinished == other.size())
+                throw std::length_error("line exceeds the line buffer");
+
+            std::copy(data + begin_, data + end_, other.data());
+            current_ = 1 - current_;
+            begin_ = 0;
+            end_ = unfinished;
+
+            if (const auto n = read_some(*fd_, other.data() + end_, other.size() - end_); n > 0)
+                end_ += n;
+            else
+                at_end_ = true;
+        }
+    }
+
+    class iterator {
+    public:
+        using value_type = std::string_view;
+        using difference_type = std::ptrdiff_t;
+
+        iterator() = default;
+
+        explicit iterator(line_source& source)
+            : source_(&source)
+            , line_(source.next())
+        {
+        }
+
+        std::string_view operator*() const { return *line_; }
+
+        iterator& operator++()
+        {
+            line_ = source_->next();
+            return *this;
+        }
+
+        void operator++(int) { ++*this; }
+
+        friend bool operator==(const iterator& it, std::default_sentinel_t) { return !it.line_; }
+
+    private:
+        line_source* source_ = nullptr;
+        std::optional<std::string_view> line_;
+    };
+
+    iterator begin() { return iterator(*this); }
+    std::default_sentinel_t end() const { return {}; }
+
+private:
+    std::string_view text_;
+
+    std::optional<int> fd_;
+    std::array<std::vector<char>, 2> buffers_;
+    size_t current_ = 0;
+    size_t begin_ = 0;
+    size_t end_ = 0;
+    bool at_end_ = false;
+};
+
+static_assert(std::ranges::input_range<line_source>);
+
+}
+
+// the lines of the input of the calling thread (see QUXFLUX_GET_INPUT), streamed from quxflux::input_fd if set
+#define QUXFLUX_GET_INPUT_LINES() \
+    (quxflux::input_is_streamed() ? quxflux::line_source(quxflux::take_input_fd()) : quxflux::line_source(QUXFLUX_GET_INPUT()))
@@ -1,13 +1,19 @@
 #pragma once
 
+#include <aoc23/snapshot.h>
 #include <aoc23/util.h>
 
+#include <array>
 #include <cstdint>
+#include <execution>
+#include <limits>
+#include <numeric>
 #include <ostream>
 #include <ranges>
 #include <span>
 #include <stdexcept>
 #include <string_view>
+#include <type_traits>
 #include <vector>
 
 namespace quxflux::aoc {
@@ -93,4 +99,200 @@ map<T> read_map(const std::string_view char_2d, detail::invocable_r<T, char> aut
     std::ranges::transform(lines | std::views::join, r.data().begin(), char_convert_f);
     return r;
 }
-}
\ No newline at end of file
+
+// stores the map as two sections of a snapshot: its dimensions and its cells
+template <typename T>
+    requires std::is_trivially_copyable_v<T>
+void add_sections(snapshot_writer& writer, const map<T>& m)
+{
+    const std::array dims { m.rows(), m.cols() };
+    writer.add(std::span<const size_t> { dims }).add(m.data());
+}
+
+// whether the snapshot's sections starting at first_section hold a map stored by add_sections whose cells all satisfy
+// is_valid_cell
+template <typename T>
+bool holds_map(const snapshot& s, const size_t first_section, const std::predicate<T> auto& is_valid_cell)
+{
+    if (s.num_sections() < first_section + 2)
+        return false;
+
+    const auto dims = s.section<size_t>(first_section);
+    const auto cells = s.section<T>(first_section + 1);
+
+    return dims.size() == 2 && dims[0] != 0 && dims[1] != 0 && cells.size() / dims[1] == dims[0] && cells.size() % dims[1] == 0 &&
+        std::ranges::all_of(cells, is_valid_cell);
+}
+
+// the map stored by add_sections at the snapshot's sections starting at first_section; the map owns its cells, so
+// they are copied out of the snapshot (in a single pass, there is nothing to parse)
+template <typename T>
+map<T> map_from_sections(const snapshot& s, const size_t first_section)
+{
+    const auto dims = s.section<size_t>(first_section);
+    const auto cells = s.section<T>(first_section + 1);
+
+    map<T> m(dims[0], dims[1]);
+    std::ranges::copy(cells, m.data().begin());
+    return m;
+}
+
+namespace detail {
+    // scanline fill of the 4-connected region around (row, col) within the rows [row_begin, row_end): is_fillable(r, c)
+    // tells whether a cell belongs to the region and is not filled yet, fill(r, c) fills it; only the seeds of
+    // horizontal spans are kept on the stack; returns the number of filled cells
+    size_t scanline_fill(const size_t row_begin, const size_t row_end, const size_t cols, const size_t row, const size_t col, const auto& is_fillable, const auto& fill)
+    {
+        std::vector<std::pair<size_t, size_t>> seeds { { row, col } };
+        size_t num_filled = 0;
+
+        while (!seeds.empty()) {
+            const auto [r, c] = seeds.back();
+            seeds.pop_back();
+
+            if (!is_fillable(r, c))
+                continue;
+
+            size_t first = c;
+            while (first > 0 && is_fillable(r, first - 1))
+                --first;
+
+            size_t last = c;
+            while (last + 1 < cols && is_fillable(r, last + 1))
+                ++last;
+
+            for (size_t i = first; i <= last; ++i)
+                fill(r, i);
+
+            num_filled += last - first + 1;
+
+            const auto push_spans = [&](const size_t adjacent_row) {
+                for (size_t i = first; i <= last; ++i)
+                    if (is_fillable(adjacent_row, i) && (i == first || !is_fillable(adjacent_row, i - 1)))
+                        seeds.emplace_back(adjacent_row, i);
+            };
+
+            if (r > row_begin)
+                push_spans(r - 1);
+            if (r + 1 < row_end)
+                push_spans(r + 1);
+        }
+
+        return num_filled;
+    }
+}
+
+// replaces the 4-connected region of cells equal to m(row, col) by fill_value, returns the number of replaced cells
+template <typename T>
+size_t flood_fill(map<T>& m, const size_t row, const size_t col, const T& fill_value)
+{
+    const T target = m(row, col);
+
+    if (target == fill_value)
+        return 0;
+
+    return detail::scanline_fill(0, m.rows(), m.cols(), row, col, [&](const size_t r, const size_t c) { return m(r, c) == target; }, [&](const size_t r, const size_t c) { m(r, c) = fill_value; });
+}
+
+struct region_labels {
+    map<uint32_t> labels;
+    size_t num_regions = 0;
+};
+
+namespace detail {
+    constexpr uint32_t unlabeled = std::numeric_limits<uint32_t>::max();
+
+    // labels the regions of the rows [row_begin, row_end) independently of the other rows, starting with label 0
+    template <typename T>
+    uint32_t label_band(const map<T>& m, map<uint32_t>& labels, const size_t row_begin, const size_t row_end)
+    {
+        uint32_t num_labels = 0;
+
+        for (size_t row = row_begin; row < row_end; ++row) {
+            for (size_t col = 0; col < m.cols(); ++col) {
+                if (labels(row, col) != unlabeled)
+                    continue;
+
+                const T& value = m(row, col);
+                scanline_fill(row_begin, row_end, m.cols(), row, col, [&](const size_t r, const size_t c) { return labels(r, c) == unlabeled && m(r, c) == value; }, [&](const size_t r, const size_t c) { labels(r, c) = num_labels; });
+                ++num_labels;
+            }
+        }
+
+        return num_labels;
+    }
+
+    // labels bands of rows concurrently (depending on the policy) and merges the labels of equal neighboring cells
+    // across the band seams afterwards; the regions are numbered in the order of their first cell
+    template <typename ExecutionPolicy, typename T>
+    region_labels label_regions_in_bands(ExecutionPolicy&& policy, const map<T>& m, const size_t num_bands)
+    {
+        region_labels result { .labels = map<uint32_t>(m.rows(), m.cols()) };
+        std::ranges::fill(result.labels.data(), unlabeled);
+
+        auto& labels = result.labels;
+
+        const auto bands = chunk_ranges(m.rows(), num_bands);
+        const std::vector band_indices { std::from_range, std::views::iota(size_t { 0 }, bands.size()) };
+
+        std::vector<uint32_t> first_label(bands.size() + 1);
+        std::for_each(policy, band_indices.begin(), band_indices.end(), [&](const size_t band) {
+            first_label[band + 1] = label_band(m, labels, bands[band].first, bands[band].second);
+        });
+        std::inclusive_scan(first_label.begin(), first_label.end(), first_label.begin());
+
+        // union find over the band local labels, the root of a set being its smallest label
+        std::vector<uint32_t> parent { std::from_range, std::views::iota(uint32_t { 0 }, first_label.back()) };
+
+        const auto find = [&](uint32_t label) {
+            while (parent[label] != label)
+                label = parent[label] = parent[parent[label]];
+            return label;
+        };
+
+        for (size_t band = 1; band < bands.size(); ++band) {
+            const auto seam = bands[band].first;
+            if (seam == bands[band].second)
+                continue;
+
+            for (size_t c = 0; c < m.cols(); ++c) {
+                if (m(seam - 1, c) != m(seam, c))
+                    continue;
+
+                const auto top = find(first_label[band - 1] + labels(seam - 1, c));
+                const auto bottom = find(first_label[band] + labels(seam, c));
+                parent[std::max(top, bottom)] = std::min(top, bottom);
+            }
+        }
+
+        std::vector<uint32_t> final_label(parent.size());
+        for (uint32_t label = 0; label < parent.size(); ++label) {
+            const auto root = find(label);
+            final_label[label] = root == label ? static_cast<uint32_t>(result.num_regions++) : final_label[root];
+        }
+
+        std::for_each(policy, band_indices.begin(), band_indices.end(), [&](const size_t band) {
+            for (size_t r = bands[band].first; r < bands[band].second; ++r)
+                for (size_t c = 0; c < m.cols(); ++c)
+                    labels(r, c) = final_label[first_label[band] + labels(r, c)];
+        });
+
+        return result;
+    }
+}
+
+// labels the 4-connected regions of equal cells, numbered in the order of their first cell
+template <typename T>
+region_labels label_regions(const map<T>& m)
+{
+    return detail::label_regions_in_bands(std::execution::seq, m, 1);
+}
+
+// parallel variant of label_regions processing bands of rows concurrently
+template <typename T>
+region_labels label_regions(const std::execution::parallel_policy& policy, const map<T>& m)
+{
+    constexpr size_t min_cells_per_band = 1 << 16;
+    return detail::label_regions_in_bands(policy, m, std::min(m.rows(), num_parallel_chunks(m.rows() * m.cols(), min_cells_per_band)));
+}
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define QUXFLUX_HAS_PERF_EVENTS 1
+#endif
+
+namespace quxflux {
+
+enum class hardware_event { cycles, instructions, l1d_read_misses, llc_read_misses, branch_misses };
+
+constexpr size_t num_hardware_events = 5;
+constexpr std::array<std::string_view, num_hardware_events> hardware_event_names { "cycles", "instructions", "L1d read misses", "LLC read misses", "branch misses" };
+
+// hardware counters of the calling thread read through perf_event_open; every event the kernel grants access to is
+// counted from construction on (kernels without perf support, containers filtering the syscall and a restrictive
+// perf_event_paranoid leave the events unavailable). work the parallel algorithms hand to threads of their own isn't
+// counted
+class perf_counters {
+public:
+    // event counts, std::nullopt for unavailable events
+    using counts = std::array<std::optional<double>, num_hardware_events>;
+
+    struct reading {
+        struct counter {
+            uint64_t value = 0;
+            uint64_t time_enabled = 0;
+            uint64_t time_running = 0;
+        };
+
+        std::array<std::optional<counter>, num_hardware_events> counters;
+    };
+
+    perf_counters()
+    {
+#if QUXFLUX_HAS_PERF_EVENTS
+        for (size_t i = 0; i < num_hardware_events; ++i) {
+            perf_event_attr attr {};
+            attr.size = sizeof(attr);
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+
+            constexpr auto cache_read_miss = [](const uint64_t cache) { return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16); };
+
+            switch (static_cast<hardware_event>(i)) {
+            case hardware_event::cycles:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_CPU_CYCLES;
+                break;
+            case hardware_event::instructions:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+                break;
+            case hardware_event::l1d_read_misses:
+                attr.type = PERF_TYPE_HW_CACHE;
+                attr.config = cache_read_miss(PERF_COUNT_HW_CACHE_L1D);
+                break;
+            case hardware_event::llc_read_misses:
+                attr.type = PERF_TYPE_HW_CACHE;
+                attr.config = cache_read_miss(PERF_COUNT_HW_CACHE_LL);
+                break;
+            case hardware_event::branch_misses:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+                break;
+            }
+
+            const auto fd = ::syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+
+            if (fd >= 0)
+                fds_[i] = static_cast<int>(fd);
+            else if (unavailable_reason_.empty())
+                unavailable_reason_ = "perf_event_open: " + std::system_category().message(errno);
+        }
+#else
+        unavailable_reason_ = "no perf_event_open on this platform";
+#endif
+    }
+
+    perf_counters(const perf_counters&) = delete;
+    perf_counters& operator=(const perf_counters&) = delete;
+
+    ~perf_counters()
+    {
+#if QUXFLUX_HAS_PERF_EVENTS
+        for (const auto fd : fds_)
+            if (fd >= 0)
+                ::close(fd);
+#endif
+    }
+
+    [[nodiscard]] bool any_available() const
+    {
+        return std::ranges::any_of(fds_, [](const int fd) { return fd >= 0; });
+    }
+
+    // why (some) events are unavailable, empty if all of them are available
+    [[nodiscard]] const std::string& unavailable_reason() const { return unavailable_reason_; }
+
+    [[nodiscard]] reading read() const
+    {
+        reading r;
+
+#if QUXFLUX_HAS_PERF_EVENTS
+        for (size_t i = 0; i < num_hardware_events; ++i) {
+            reading::counter c;
+            if (fds_[i] >= 0 && ::read(fds_[i], &c, sizeof(c)) == sizeof(c))
+                r.counters[i] = c;
+        }
+#endif
+
+        return r;
+    }
+
+    // the events counted between two readings, scaled up for the time an event wasn't scheduled on the pmu
+    // (multiplexing)
+    static counts between(const reading& begin, const reading& end)
+    {
+        counts result;
+
+        for (size_t i = 0; i < num_hardware_events; ++i) {
+            const auto& b = begin.counters[i];
+            const auto& e = end.counters[i];
+
+            if (!b || !e || e->time_running <= b->time_running)
+                continue;
+
+            result[i] = static_cast<double>(e->value - b->value) * static_cast<double>(e->time_enabled - b->time_enabled) /
+                static_cast<double>(e->time_running - b->time_running);
+        }
+
+        return result;
+    }
+
+private:
+    std::array<int, num_hardware_events> fds_ { -1, -1, -1, -1, -1 };
+    std::string unavailable_reason_;
+};
+
+}
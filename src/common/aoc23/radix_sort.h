@@ -0,0 +1,93 @@
+#pragma once
+
+#include <aoc23/util.h>
+
+#include <array>
+#include <cstdint>
+#include <execution>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace quxflux {
+
+namespace detail {
+    // every pass histograms and scatters the chunks of the keys independently (and concurrently, depending on the policy);
+    // the digit offsets are laid out digit by digit and chunk by chunk which keeps the sort stable
+    template <typename ExecutionPolicy, typename T>
+    void chunked_radix_sort(ExecutionPolicy&& policy, const std::span<uint32_t> keys, const std::span<T> values, const unsigned key_bits, const size_t num_chunks)
+    {
+        if (keys.size() != values.size())
+            throw std::invalid_argument("keys and values differ in size");
+
+        constexpr unsigned digit_bits = 8;
+        constexpr uint32_t digit_mask = (1u << digit_bits) - 1;
+
+        using digit_offsets = std::array<size_t, digit_mask + 1>;
+
+        std::vector<uint32_t> key_buffer(keys.size());
+        std::vector<T> value_buffer(values.size());
+
+        std::span<uint32_t> src_keys = keys;
+        std::span<T> src_values = values;
+        std::span<uint32_t> dst_keys = key_buffer;
+        std::span<T> dst_values = value_buffer;
+
+        const auto chunks = chunk_ranges(keys.size(), num_chunks);
+        std::vector<digit_offsets> offsets(chunks.size());
+        const std::vector chunk_indices { std::from_range, std::views::iota(size_t { 0 }, chunks.size()) };
+
+        for (unsigned shift = 0; shift < key_bits; shift += digit_bits) {
+            std::for_each(policy, chunk_indices.begin(), chunk_indices.end(), [&](const size_t chunk) {
+                auto& chunk_offsets = offsets[chunk];
+                chunk_offsets.fill(0);
+
+                const auto [begin, end] = chunks[chunk];
+                for (const auto key : src_keys.subspan(begin, end - begin))
+                    ++chunk_offsets[(key >> shift) & digit_mask];
+            });
+
+            size_t offset = 0;
+            for (size_t digit = 0; digit <= digit_mask; ++digit)
+                for (auto& chunk_offsets : offsets)
+                    offset += std::exchange(chunk_offsets[digit], offset);
+
+            std::for_each(policy, chunk_indices.begin(), chunk_indices.end(), [&](const size_t chunk) {
+                auto& chunk_offsets = offsets[chunk];
+
+                for (size_t i = chunks[chunk].first; i < chunks[chunk].second; ++i) {
+                    const auto dst_idx = chunk_offsets[(src_keys[i] >> shift) & digit_mask]++;
+                    dst_keys[dst_idx] = src_keys[i];
+                    dst_values[dst_idx] = std::move(src_values[i]);
+                }
+            });
+
+            std::swap(src_keys, dst_keys);
+            std::swap(src_values, dst_values);
+        }
+
+        if (src_keys.data() != keys.data()) {
+            std::ranges::copy(src_keys, keys.begin());
+            std::ranges::move(src_values, values.begin());
+        }
+    }
+}
+
+// stable LSD radix sort of keys considering only their lowest key_bits bits; values are permuted alongside the keys
+template <typename T>
+void radix_sort(const std::span<uint32_t> keys, const std::span<T> values, const unsigned key_bits = 32)
+{
+    detail::chunked_radix_sort(std::execution::seq, keys, values, key_bits, 1);
+}
+
+// parallel variant of radix_sort
+template <typename T>
+void radix_sort(const std::execution::parallel_policy& policy, const std::span<uint32_t> keys, const std::span<T> values, const unsigned key_bits = 32)
+{
+    constexpr size_t min_chunk_size = 1 << 16;
+    detail::chunked_radix_sort(policy, keys, values, key_bits, num_parallel_chunks(keys.size(), min_chunk_size));
+}
+
+}
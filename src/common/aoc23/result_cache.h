@@ -0,0 +1,62 @@
+#pragma once
+
+#include <aoc23/hash.h>
+#include <aoc23/util.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+namespace quxflux {
+
+// answers stored on disk, one file per (day, part, solver version, input hash); files are written under a temporary
+// name and renamed into place, so readers never see a partially written answer. the cache is best effort: failing to
+// write an entry is not an error
+class result_cache {
+public:
+    explicit result_cache(std::filesystem::path directory)
+        : directory_(std::move(directory))
+    {
+        std::filesystem::create_directories(directory_);
+    }
+
+    struct key {
+        unsigned day = 0;
+        size_t part = 0;
+        std::string_view solver_version;
+        uint64_t input_hash = 0;
+    };
+
+    [[nodiscard]] std::optional<std::string> find(const key& k) const
+    {
+        std::ifstream file(path_of(k), std::ios::binary);
+        if (!file)
+            return std::nullopt;
+
+        std::string answer { std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+        if (file.bad())
+            return std::nullopt;
+
+        return answer;
+    }
+
+    void store(const key& k, const std::string_view answer) const { write_file_atomically(path_of(k), answer); }
+
+private:
+    [[nodiscard]] std::filesystem::path path_of(const key& k) const
+    {
+        std::ostringstream name;
+        name << "day_" << std::setw(2) << std::setfill('0') << k.day << "_part_" << k.part << '_' << to_hex(xxh64(k.solver_version)) << '_' << to_hex(k.input_hash);
+
+        return directory_ / name.str();
+    }
+
+    std::filesystem::path directory_;
+};
+
+}
@@ -0,0 +1,375 @@
+#pragma once
+
+#include <aoc23/allocation_stats.h>
+#include <aoc23/hash.h>
+#include <aoc23/util.h>
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define QUXFLUX_HAS_MMAP 1
+#endif
+
+namespace quxflux {
+
+// directory the driver keeps the snapshots of parsed models in (--snapshots), unset if snapshots are disabled
+inline std::optional<std::filesystem::path> snapshot_directory;
+
+// a snapshot file stores the arrays making up a day's parsed model:
+//   header, section table, sections
+// each section starts at a multiple of snapshot_alignment, so that the file can be mapped and its sections used in place;
+// the file stores the arrays in the native byte order and is rejected on a machine of another byte order
+constexpr size_t snapshot_alignment = 64;
+
+struct snapshot_header {
+    static constexpr std::array<char, 8> expected_magic { 'A', 'O', 'C', '2', '3', 'S', 'N', 'P' };
+    static constexpr uint32_t current_format_version = 1;
+    static constexpr uint32_t native_byte_order = 0x01020304;
+
+    std::array<char, 8> magic = expected_magic;
+    uint32_t format_version = current_format_version;
+    uint32_t byte_order = native_byte_order;
+    uint32_t day = 0;
+    uint32_t model_version = 0;
+    uint64_t input_hash = 0;
+    uint64_t num_sections = 0;
+};
+
+struct snapshot_section {
+    uint64_t offset = 0;
+    uint64_t size = 0;
+};
+
+static_assert(std::is_trivially_copyable_v<snapshot_header> && std::is_trivially_copyable_v<snapshot_section>);
+
+// identifies the model of an input; model_version is to be raised whenever the layout of a day's model changes
+struct snapshot_key {
+    unsigned day = 0;
+    uint32_t model_version = 0;
+    uint64_t input_hash = 0;
+
+    bool operator==(const snapshot_key&) const = default;
+
+    [[nodiscard]] std::filesystem::path path_in(const std::filesystem::path& directory) const
+    {
+        std::ostringstream name;
+        name << "day_" << std::setw(2) << std::setfill('0') << day << '_' << to_hex(input_hash) << ".snapshot";
+        return directory / name.str();
+    }
+};
+
+namespace detail {
+    inline std::shared_ptr<std::byte[]> allocate_snapshot_buffer(const size_t size)
+    {
+        return { new (std::align_val_t { snapshot_alignment }) std::byte[size], [](std::byte* b) { ::operator delete[](b, std::align_val_t { snapshot_alignment }); } };
+    }
+}
+
+// a snapshot file mapped into memory (or read into an aligned buffer where mmap isn't available), or a snapshot built
+// in memory by a snapshot_writer
+class snapshot {
+public:
+    // the snapshot of the given key from the snapshot_directory, std::nullopt if snapshots are disabled or there is no
+    // valid snapshot for the key
+    static std::optional<snapshot> open(const snapshot_key& key)
+    {
+        if (!snapshot_directory)
+            return std::nullopt;
+
+        auto data = map_file(key.path_in(*snapshot_directory));
+        if (!data || !is_valid(key, data->bytes))
+            return std::nullopt;
+
+        return snapshot(std::move(*data));
+    }
+
+    // writes the snapshot to the snapshot_directory (if any) atomically; failing to write it is not an error, the model
+    // is parsed again next time
+    void save(const snapshot_key& key) const
+    {
+        if (!snapshot_directory)
+            return;
+
+        std::error_code ec;
+        std::filesystem::create_directories(*snapshot_directory, ec);
+        write_file_atomically(key.path_in(*snapshot_directory), { reinterpret_cast<const char*>(data_.bytes.data()), data_.bytes.size() });
+    }
+
+    [[nodiscard]] size_t num_sections() const { return static_cast<size_t>(header().num_sections); }
+
+    // the section as array of T, used in place
+    template <typename T>
+        requires std::is_trivially_copyable_v<T>
+    [[nodiscard]] std::span<const T> section(const size_t idx) const
+    {
+        if (idx >= num_sections())
+            throw std::out_of_range("no such snapshot section");
+
+        const auto entry = read<snapshot_section>(sizeof(snapshot_header) + idx * sizeof(snapshot_section));
+
+        if (entry.size % sizeof(T) != 0)
+            throw std::invalid_argument("snapshot section size mismatch");
+
+        // sections are aligned to snapshot_alignment within a page aligned mapping
+        static_assert(alignof(T) <= snapshot_alignment);
+        return { reinterpret_cast<const T*>(data_.bytes.data() + entry.offset), static_cast<size_t>(entry.size / sizeof(T)) };
+    }
+
+private:
+    friend class snapshot_writer;
+
+    struct mapped_file {
+        std::shared_ptr<const void> owner;
+        std::span<const std::byte> bytes;
+    };
+
+    explicit snapshot(mapped_file data)
+        : data_(std::move(data))
+    {
+    }
+
+    template <typename T>
+    static T read(const std::span<const std::byte> bytes, const size_t offset)
+    {
+        T value;
+        std::memcpy(&value, bytes.data() + offset, sizeof(T));
+        return value;
+    }
+
+    template <typename T>
+    [[nodiscard]] T read(const size_t offset) const
+    {
+        return read<T>(data_.bytes, offset);
+    }
+
+    [[nodiscard]] snapshot_header header() const { return read<snapshot_header>(0); }
+
+    static bool is_valid(const snapshot_key& key, const std::span<const std::byte> bytes)
+    {
+        if (bytes.size() < sizeof(snapshot_header))
+            return false;
+
+        const auto header = read<snapshot_header>(bytes, 0);
+
+        if (header.magic != snapshot_header::expected_magic || header.format_version != snapshot_header::current_format_version ||
+            header.byte_order != snapshot_header::native_byte_order)
+            return false;
+
+        if (header.day != key.day || header.model_version != key.model_version || header.input_hash != key.input_hash)
+            return false;
+
+        if (header.num_sections > (bytes.size() - sizeof(snapshot_header)) / sizeof(snapshot_section))
+            return false;
+
+        for (size_t i = 0; i < header.num_sections; ++i) {
+            const auto section = read<snapshot_section>(bytes, sizeof(snapshot_header) + i * sizeof(snapshot_section));
+
+            if (section.offset % snapshot_alignment != 0 || section.offset > bytes.size() || section.size > bytes.size() - section.offset)
+                return false;
+        }
+
+        return true;
+    }
+
+    static std::optional<mapped_file> map_file(const std::filesystem::path& path)
+    {
+#if QUXFLUX_HAS_MMAP
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return std::nullopt;
+
+        struct stat st {};
+        const bool has_size = ::fstat(fd, &st) == 0 && st.st_size > 0;
+        void* const address = has_size ? ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        ::close(fd);
+
+        if (address == MAP_FAILED)
+            return std::nullopt;
+
+        const auto size = static_cast<size_t>(st.st_size);
+        return mapped_file { .owner = std::shared_ptr<const void>(address, [size](const void* a) { ::munmap(const_cast<void*>(a), size); }),
+            .bytes = { static_cast<const std::byte*>(address), size } };
+#else
+        std::error_code ec;
+        const auto size = static_cast<size_t>(std::filesystem::file_size(path, ec));
+        if (ec)
+            return std::nullopt;
+
+        const auto buffer = detail::allocate_snapshot_buffer(size);
+
+        std::ifstream file(path, std::ios::binary);
+        if (!file.read(reinterpret_cast<char*>(buffer.get()), static_cast<std::streamsize>(size)))
+            return std::nullopt;
+
+        return mapped_file { .owner = buffer, .bytes = { buffer.get(), size } };
+#endif
+    }
+
+    mapped_file data_;
+};
+
+// collects (copies of) the sections of a model and lays them out as snapshot
+class snapshot_writer {
+public:
+    template <typename T>
+        requires std::is_trivially_copyable_v<T>
+    snapshot_writer& add(const std::span<const T> section)
+    {
+        const auto bytes = std::as_bytes(section);
+        sections_.emplace_back(bytes.begin(), bytes.end());
+        return *this;
+    }
+
+    // the snapshot of the sections in an aligned buffer of its own
+    [[nodiscard]] snapshot build(const snapshot_key& key) const
+    {
+        const auto align = [](const size_t offset) { return (offset + snapshot_alignment - 1) / snapshot_alignment * snapshot_alignment; };
+
+        const snapshot_header header { .day = key.day, .model_version = key.model_version, .input_hash = key.input_hash, .num_sections = sections_.size() };
+
+        std::vector<snapshot_section> table;
+        size_t offset = align(sizeof(snapshot_header) + sections_.size() * sizeof(snapshot_section));
+
+        for (const auto& section : sections_) {
+            table.push_back({ .offset = offset, .size = section.size() });
+            offset = align(offset + section.size());
+        }
+
+        const auto buffer = detail::allocate_snapshot_buffer(offset);
+        std::memset(buffer.get(), 0, offset);
+        std::memcpy(buffer.get(), &header, sizeof(header));
+        std::memcpy(buffer.get() + sizeof(header), table.data(), table.size() * sizeof(snapshot_section));
+
+        for (const auto& [section, entry] : std::views::zip(sections_, table))
+            std::memcpy(buffer.get() + entry.offset, section.data(), section.size());
+
+        return snapshot({ .owner = buffer, .bytes = { buffer.get(), offset } });
+    }
+
+private:
+    std::vector<std::vector<std::byte>> sections_;
+};
+
+// the models of the inputs used most recently, kept in memory by the daemon (see serve) so that a request for an input
+// seen before neither parses it again nor maps its snapshot; holds up to capacity models, evicting the least recently
+// used one
+class model_cache {
+public:
+    explicit model_cache(const size_t capacity)
+        : capacity_(std::max(capacity, size_t { 1 }))
+    {
+    }
+
+    std::optional<snapshot> find(const snapshot_key& key)
+    {
+        const std::scoped_lock lock(mutex_);
+
+        const auto it = std::ranges::find(models_, key, &entry::key);
+        if (it == models_.end())
+            return std::nullopt;
+
+        std::rotate(it, std::next(it), models_.end());
+        return models_.back().model;
+    }
+
+    // two requests for the same input may both have parsed it, the model inserted first is kept then
+    void insert(const snapshot_key& key, const snapshot& model)
+    {
+        const std::scoped_lock lock(mutex_);
+
+        if (std::ranges::contains(models_, key, &entry::key))
+            return;
+
+        if (models_.size() == capacity_)
+            models_.pop_front();
+
+        models_.push_back({ .key = key, .model = model });
+    }
+
+private:
+    struct entry {
+        snapshot_key key;
+        snapshot model;
+    };
+
+    size_t capacity_;
+    std::mutex mutex_;
+    std::deque<entry> models_;
+};
+
+// enabled by the daemon only, a single run uses every model once
+inline std::optional<model_cache> warm_models;
+
+// the model of the input as snapshot, its sections to be used in place: the warm model of the input if there is one,
+// else the input's snapshot from the snapshot_directory if there is one passing is_valid (which checks the contents
+// beyond the format and may throw on sections of unexpected size), otherwise the model parse returns (as
+// snapshot_writer) from the input, which is then saved to the snapshot_directory for the next run
+template <std::invocable Parse, std::predicate<const snapshot&> IsValid>
+    requires std::same_as<std::invoke_result_t<Parse>, snapshot_writer>
+snapshot load_model(const unsigned day, const uint32_t model_version, const std::string_view input, const Parse& parse, const IsValid& is_valid)
+{
+    const allocation_phase phase("load model");
+
+    const auto parse_and_build = [&](const snapshot_key& key) {
+        const allocation_phase parse_phase("parse");
+        return parse().build(key);
+    };
+
+    // the input is only hashed if the model is looked up at all
+    snapshot_key key { .day = day, .model_version = model_version };
+
+    if (!snapshot_directory && !warm_models)
+        return parse_and_build(key);
+
+    key.input_hash = xxh64(input);
+
+    if (warm_models)
+        if (auto warm = warm_models->find(key))
+            return *std::move(warm);
+
+    const auto model = [&] {
+        if (auto existing = snapshot::open(key)) {
+            try {
+                if (is_valid(*existing))
+                    return *std::move(existing);
+            } catch (const std::exception&) {
+            }
+        }
+
+        auto parsed = parse_and_build(key);
+        parsed.save(key);
+        return parsed;
+    }();
+
+    if (warm_models)
+        warm_models->insert(key, model);
+
+    return model;
+}
+
+}
@@ -2,20 +2,120 @@
 
 #include <algorithm>
 #include <array>
+#include <cerrno>
+#include <climits>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
 #include <functional>
 #include <iostream>
+#include <optional>
+#include <random>
 #include <ranges>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
 namespace quxflux {
 
+// the days relying on 128 bit arithmetic refuse to build without it (see QUXFLUX_HAS_UINT128)
+#if defined(__SIZEOF_INT128__)
+#define QUXFLUX_HAS_UINT128 1
+using uint128 = unsigned __int128;
+#endif
+
 constexpr bool is_digit(const char c) { return c >= '0' && c <= '9'; }
 constexpr auto as_string_view = [](const std::constructible_from<std::string_view> auto& str) { return std::string_view { str }; };
 
+// parses an unsigned integer (skipping leading blanks) from the front of str and advances str past it
+template <std::unsigned_integral T = size_t>
+constexpr std::optional<T> consume_uint(std::string_view& str)
+{
+    const auto first_non_blank = str.find_first_not_of(" \t");
+    str.remove_prefix(first_non_blank == std::string_view::npos ? str.size() : first_non_blank);
+
+    if (str.empty() || !is_digit(str.front()))
+        return std::nullopt;
+
+    T value = 0;
+    while (!str.empty() && is_digit(str.front())) {
+        value = value * 10 + static_cast<T>(str.front() - '0');
+        str.remove_prefix(1);
+    }
+
+    return value;
+}
+
+// parses a signed integer (skipping leading blanks, the sign has to be followed by a digit directly) from the front of
+// str and advances str past it
+template <std::signed_integral T = ptrdiff_t>
+constexpr std::optional<T> consume_int(std::string_view& str)
+{
+    const auto first_non_blank = str.find_first_not_of(" \t");
+    str.remove_prefix(first_non_blank == std::string_view::npos ? str.size() : first_non_blank);
+
+    const bool negative = str.starts_with('-');
+    if (negative) {
+        if (str.size() < 2 || !is_digit(str[1]))
+            return std::nullopt;
+
+        str.remove_prefix(1);
+    }
+
+    const auto magnitude = consume_uint<std::make_unsigned_t<T>>(str);
+    if (!magnitude)
+        return std::nullopt;
+
+    return static_cast<T>(negative ? std::make_unsigned_t<T> { 0 } - *magnitude : *magnitude);
+}
+
+// number of chunks to split size elements into for processing them in parallel, each chunk holding at least
+// min_chunk_size elements
+inline size_t num_parallel_chunks(const size_t size, const size_t min_chunk_size)
+{
+    const size_t max_num_chunks = std::max(size_t { 1 }, size_t { std::thread::hardware_concurrency() } * 4);
+    return std::clamp(size / std::max(min_chunk_size, size_t { 1 }), size_t { 1 }, max_num_chunks);
+}
+
+// splits [0, size) into num_chunks contiguous [begin, end) ranges of (almost) equal size
+inline std::vector<std::pair<size_t, size_t>> chunk_ranges(const size_t size, const size_t num_chunks)
+{
+    return std::vector { std::from_range, std::views::iota(size_t { 0 }, num_chunks) | std::views::transform([=](const size_t i) {
+        return std::pair { i * size / num_chunks, (i + 1) * size / num_chunks };
+    }) };
+}
+
+// splits str into at most num_chunks consecutive pieces, each but the last ending with a line break
+inline std::vector<std::string_view> split_into_line_chunks(std::string_view str, const size_t num_chunks)
+{
+    std::vector<std::string_view> chunks;
+    const size_t approx_chunk_size = str.size() / std::max(num_chunks, size_t { 1 }) + 1;
+
+    while (!str.empty()) {
+        const auto line_break = str.find('\n', std::min(approx_chunk_size, str.size()) - 1);
+        const auto chunk_size = line_break == std::string_view::npos ? str.size() : line_break + 1;
+
+        chunks.push_back(str.substr(0, chunk_size));
+        str.remove_prefix(chunk_size);
+    }
+
+    return chunks;
+}
+
 inline std::string read_file(const std::filesystem::path& path)
 {
     std::ifstream file(path);
@@ -24,6 +124,116 @@ inline std::string read_file(const std::filesystem::path& path)
     return oss.str();
 }
 
+// writes data to a temporary file next to path and renames it into place, so that readers never see a partially
+// written file; returns whether the file was written
+inline bool write_file_atomically(const std::filesystem::path& path, const std::string_view data)
+{
+    std::random_device random;
+    auto temporary_path = path;
+    temporary_path += "." + std::to_string(uint64_t { random() } << 32 | random()) + ".tmp";
+
+    std::error_code ec;
+
+    {
+        std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+        file.write(data.data(), static_cast<std::streamsize>(data.size()));
+
+        if (!file.flush()) {
+            file.close();
+            std::filesystem::remove(temporary_path, ec);
+            return false;
+        }
+    }
+
+    std::filesystem::rename(temporary_path, path, ec);
+    if (ec)
+        std::filesystem::remove(temporary_path, ec);
+
+    return !ec;
+}
+
+// input handed to the parts by a driver (see driver.h) in place of the day's input.txt, per thread so that several
+// inputs can be solved concurrently
+inline thread_local std::optional<std::string_view> input_override;
+
+// overrides the input of the calling thread for the lifetime of the object
+class scoped_input {
+public:
+    explicit scoped_input(const std::string_view input)
+        : previous_(std::exchange(input_override, input))
+    {
+    }
+
+    scoped_input(const scoped_input&) = delete;
+    scoped_input& operator=(const scoped_input&) = delete;
+
+    ~scoped_input() { input_override = previous_; }
+
+private:
+    std::optional<std::string_view> previous_;
+};
+
+// reads up to size bytes from the file descriptor, returns 0 at its end
+inline size_t read_some(const int fd, char* const buffer, const size_t size)
+{
+    for (;;) {
+#if defined(_WIN32)
+        const auto n = ::_read(fd, buffer, static_cast<unsigned>(std::min<size_t>(size, INT_MAX)));
+#else
+        const auto n = ::read(fd, buffer, size);
+#endif
+        if (n >= 0)
+            return static_cast<size_t>(n);
+
+        if (errno != EINTR)
+            throw std::system_error(errno, std::generic_category(), "read");
+    }
+}
+
+// file descriptor the input is streamed from in place of input.txt (see driver.h), per thread like input_override
+inline thread_local std::optional<int> input_fd;
+inline thread_local bool input_fd_consumed = false;
+
+// input_fd for its one reader: a stream can be read only once, so any later attempt to read it throws rather than
+// silently falling back to input.txt
+inline int take_input_fd()
+{
+    if (std::exchange(input_fd_consumed, true))
+        throw std::logic_error("input stream already consumed");
+
+    return *input_fd;
+}
+
+// whether the input of the calling thread is streamed from input_fd, i.e. it isn't (or no longer) in memory
+inline bool input_is_streamed()
+{
+    return input_fd && !input_override;
+}
+
+// the input of the calling thread: the override, else everything to read from input_fd (kept as override for further
+// calls), else read_default()
+template <std::invocable F>
+std::string_view current_input(const F& read_default)
+{
+    if (input_override)
+        return *input_override;
+
+    if (input_fd) {
+        thread_local std::string streamed_input;
+
+        const int fd = take_input_fd();
+
+        std::array<char, 1 << 16> chunk;
+        while (const auto n = read_some(fd, chunk.data(), chunk.size()))
+            streamed_input.append(chunk.data(), n);
+
+        input_override = streamed_input;
+        return streamed_input;
+    }
+
+    return read_default();
+}
+
 template <template <typename...> typename Container, std::ranges::input_range Range>
 auto from_range(Range&& r)
 {
@@ -32,5 +242,8 @@ auto from_range(Range&& r)
 
 }
 
-#define QUXFLUX_GET_INPUT() [] { const static auto str = quxflux::read_file(std::filesystem::path(__FILE__).parent_path() / "input.txt"); \
-                                 return std::string_view{str}; }()
+// the input.txt next to the source file of the day
+#define QUXFLUX_INPUT_PATH() (std::filesystem::path(__FILE__).parent_path() / "input.txt")
+
+#define QUXFLUX_GET_INPUT() quxflux::current_input([] { const static auto str = quxflux::read_file(QUXFLUX_INPUT_PATH()); \
+                                 return std::string_view{str}; })
@@ -1,3 +1,5 @@
+#include <aoc23/driver.h>
+#include <aoc23/line_source.h>
 #include <aoc23/util.h>
 
 #include <map>
@@ -29,7 +31,7 @@ size_t extract_line_with_digits(const std::string_view line)
 
 size_t process_input(const auto& line_extract)
 {
-    auto line_nums = QUXFLUX_GET_INPUT() | std::views::split('\n') | std::views::transform(quxflux::as_string_view) | std::views::transform(line_extract);
+    auto line_nums = QUXFLUX_GET_INPUT_LINES() | std::views::transform(line_extract);
     return std::ranges::fold_left(line_nums, size_t { 0 }, std::plus {});
 }
 
@@ -73,10 +75,7 @@ size_t part_2()
 }
 } // namespace
 
-int main()
+int main(const int argc, char* argv[])
 {
-    std::cout << part_1() << std::endl;
-    std::cout << part_2() << std::endl;
-
-    return 0;
+    return quxflux::run_puzzle(1, &part_1, &part_2, QUXFLUX_INPUT_PATH(), argc, argv);
 }
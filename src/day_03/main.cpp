@@ -1,3 +1,4 @@
+#include <aoc23/driver.h>
 #include <aoc23/util.h>
 
 #include <map>
@@ -200,9 +201,7 @@ size_t part_2()
 
 } // namespace
 
-int main()
+int main(const int argc, char* argv[])
 {
-    std::cout << part_1() << '\n';
-    std::cout << part_2() << '\n';
-    return 0;
+    return quxflux::run_puzzle(3, &part_1, &part_2, QUXFLUX_INPUT_PATH(), argc, argv);
 }
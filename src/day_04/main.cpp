@@ -1,18 +1,25 @@
+#include <aoc23/allocation_stats.h>
+#include <aoc23/driver.h>
+#include <aoc23/line_source.h>
 #include <aoc23/util.h>
 
+#include <array>
 #include <set>
+#include <tuple>
+#include <utility>
 
 namespace {
 
 struct card {
     size_t id = 0;
-    size_t quantity = 1;
     std::array<size_t, 10> winning_numbers {};
     std::array<size_t, 25> our_numbers {};
 };
 
 card card_from_line(const std::string_view line)
 {
+    const quxflux::allocation_phase phase("parse cards");
+
     const std::vector numbers {
         std::from_range, std::views::chunk_by(line, [](const auto a, const auto b) { return quxflux::is_digit(a) == quxflux::is_digit(b); }) //
             | std::views::filter([](const auto range) {
@@ -31,6 +38,8 @@ card card_from_line(const std::string_view line)
 
 size_t num_winnings_cards(const card& c)
 {
+    const quxflux::allocation_phase phase("match numbers");
+
     const std::set<size_t> a(std::from_range, c.winning_numbers);
     const std::set<size_t> b(std::from_range, c.our_numbers);
 
@@ -48,28 +57,35 @@ size_t calculate_points(const std::string_view line)
 
 size_t part_1()
 {
-    return std::ranges::fold_left(std::views::split(QUXFLUX_GET_INPUT(), '\n') | std::views::transform(quxflux::as_string_view) | std::views::transform(&calculate_points), size_t { 0 }, std::plus<>());
+    return std::ranges::fold_left(QUXFLUX_GET_INPUT_LINES() | std::views::transform(&calculate_points), size_t { 0 }, std::plus<>());
 }
 
+// a card wins copies of at most as many following cards as it has winning numbers, so the copies won for the cards to
+// come are kept in a ring buffer of that size while the cards are streamed: the slot of the current card is taken and
+// cleared before the card hands out its copies, which may then reach as far as the slot it just freed
 size_t part_2()
 {
-    std::vector cards { std::from_range, std::views::split(QUXFLUX_GET_INPUT(), '\n') | std::views::transform(quxflux::as_string_view) | std::views::transform(&card_from_line) };
+    constexpr size_t window_size = std::tuple_size_v<decltype(card::winning_numbers)>;
+    std::array<size_t, window_size> pending_copies {};
+
+    size_t num_cards = 0;
+
+    for (const auto [idx, line] : QUXFLUX_GET_INPUT_LINES() | std::views::enumerate) {
+        const auto quantity = 1 + std::exchange(pending_copies[static_cast<size_t>(idx) % window_size], 0);
+        const auto num_win = num_winnings_cards(card_from_line(line));
 
-    for (const auto&& [idx, card] : cards | std::views::enumerate) {
-        const auto num_win = num_winnings_cards(card);
+        for (size_t next = 1; next <= num_win; ++next)
+            pending_copies[(static_cast<size_t>(idx) + next) % window_size] += quantity;
 
-        for (auto& next : std::span { cards }.subspan(idx + 1, num_win))
-            next.quantity += card.quantity;
+        num_cards += quantity;
     }
 
-    return std::ranges::fold_left(cards | std::views::transform(&card::quantity), size_t { 0 }, std::plus {});
+    return num_cards;
 }
 
 } // namespace
 
-int main()
+int main(const int argc, char* argv[])
 {
-    std::cout << part_1() << '\n';
-    std::cout << part_2() << '\n';
-    return 0;
+    return quxflux::run_puzzle(4, &part_1, &part_2, QUXFLUX_INPUT_PATH(), argc, argv);
 }
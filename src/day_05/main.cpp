@@ -1,8 +1,9 @@
+#include <aoc23/allocation_stats.h>
+#include <aoc23/driver.h>
+#include <aoc23/snapshot.h>
 #include <aoc23/util.h>
 
-#include <map>
-#include <regex>
-#include <spanstream>
+#include <stdexcept>
 
 namespace {
 
@@ -12,127 +13,217 @@ struct almanac {
         std::string to;
 
         struct range {
-            size_t start {};
+            size_t source_start {};
+            size_t dest_start {};
             size_t len {};
-
-            constexpr bool operator<(const range& rhs) const noexcept
-            {
-                return start < rhs.start;
-            }
         };
 
-        std::map<range, size_t> source_to_dest;
+        // sorted by source_start
+        std::vector<range> ranges;
     };
 
     std::vector<size_t> seeds;
     std::vector<mapping> mappings;
 };
 
-size_t map_source_to_dest(const almanac::mapping& mapping, const size_t value)
+// the almanac as used by the solvers, in place from the snapshot owning it: the mapping chain is flattened, the
+// (sorted) ranges of the i-th mapping are ranges[mapping_offsets[i], mapping_offsets[i + 1])
+struct almanac_view {
+    std::span<const size_t> seeds;
+    std::span<const almanac::mapping::range> ranges;
+    std::span<const size_t> mapping_offsets;
+};
+
+size_t map_source_to_dest(const std::span<const almanac::mapping::range> ranges, const size_t value)
 {
-    auto it = mapping.source_to_dest.upper_bound(almanac::mapping::range { value, 0 });
+    const auto it = std::ranges::upper_bound(ranges, value, std::less {}, &almanac::mapping::range::source_start);
 
-    if (it == mapping.source_to_dest.begin())
+    if (it == ranges.begin())
         return value;
 
-    std::advance(it, -1);
+    const auto& range = *std::prev(it);
 
-    const auto d0 = value - it->first.start;
-    const auto d1 = (it->first.start + it->first.len) - value;
-    if (value >= it->first.start && value < it->first.start + it->first.len)
-        return it->second + value - it->first.start;
+    if (value - range.source_start < range.len)
+        return range.dest_start + (value - range.source_start);
 
     return value;
 }
 
-size_t resolve_seed(const std::span<const almanac::mapping> mappings, const size_t value)
+size_t resolve_seed(const almanac_view& almanac, const size_t value)
 {
     size_t result = value;
 
-    for (const auto& mapping : mappings)
-        result = map_source_to_dest(mapping, result);
+    for (const auto [first, last] : almanac.mapping_offsets | std::views::pairwise)
+        result = map_source_to_dest(almanac.ranges.subspan(first, last - first), result);
 
     return result;
 }
 
+// splits a "<from>-to-<to> map:" header into from and to
+constexpr std::optional<std::pair<std::string_view, std::string_view>> parse_mapping_header(std::string_view line)
+{
+    constexpr std::string_view separator { "-to-" };
+    constexpr std::string_view suffix { " map:" };
+
+    if (!line.ends_with(suffix))
+        return std::nullopt;
+
+    line.remove_suffix(suffix.size());
+
+    const auto separator_pos = line.find(separator);
+    if (separator_pos == std::string_view::npos)
+        return std::nullopt;
+
+    return std::pair { line.substr(0, separator_pos), line.substr(separator_pos + separator.size()) };
+}
+
+constexpr almanac::mapping::range parse_range(std::string_view line)
+{
+    const auto dest_start = quxflux::consume_uint(line);
+    const auto source_start = quxflux::consume_uint(line);
+    const auto len = quxflux::consume_uint(line);
+
+    if (!dest_start || !source_start || !len)
+        throw std::invalid_argument("malformed range");
+
+    return { .source_start = *source_start, .dest_start = *dest_start, .len = *len };
+}
+
+// reorders the mappings so that each one consumes what the previous one produces, starting at "seed"
+void order_mapping_chain(std::vector<almanac::mapping>& mappings)
+{
+    std::string_view category { "seed" };
+
+    for (auto it = mappings.begin(); it != mappings.end(); ++it) {
+        const auto next = std::ranges::find(it, mappings.end(), category, &almanac::mapping::from);
+
+        if (next == mappings.end())
+            throw std::invalid_argument("broken mapping chain");
+
+        std::iter_swap(it, next);
+        category = it->to;
+    }
+}
+
 almanac read_almanac()
 {
-    const std::vector lines { std::from_range, std::views::split(QUXFLUX_GET_INPUT(), '\n') | std::views::transform(quxflux::as_string_view) };
+    auto lines = QUXFLUX_GET_INPUT() | std::views::split('\n') | std::views::transform(quxflux::as_string_view);
 
     almanac result;
 
-    result.seeds = { std::from_range,
-        lines.front()
-            | std::views::chunk_by([](const auto lhs, const auto rhs) { return quxflux::is_digit(lhs) == quxflux::is_digit(rhs); }) //
-            | std::views::filter([](const auto& t) { return quxflux::is_digit(t.front()); }) //
-            | std::views::transform([](const auto& t) { return std::stoul(std::string { t.begin(), t.end() }); }) };
-
-    const std::vector mapping_descriptors {
-        std::from_range,
-        lines
-            | std::views::drop(2)
-            | std::views::chunk_by([](const auto lhs, const auto rhs) { return !lhs.empty(); })
-            | std::views::transform([](const auto t) { return std::vector { std::from_range, t | std::views::take(std::ranges::size(t) - 1) }; })
-    };
+    {
+        constexpr std::string_view seeds_prefix { "seeds:" };
+
+        auto seeds_line = *lines.begin();
+        if (!seeds_line.starts_with(seeds_prefix))
+            throw std::invalid_argument("missing seeds");
 
-    result.mappings = { std::from_range,
-        mapping_descriptors
-            | std::views::transform([](const auto& lines) -> almanac::mapping {
-                  almanac::mapping result;
+        seeds_line.remove_prefix(seeds_prefix.size());
+        while (const auto seed = quxflux::consume_uint(seeds_line))
+            result.seeds.push_back(*seed);
+    }
 
-                  {
-                      const std::regex game_regex { R"(([a-z]+)-to-([a-z]+) map:)" };
-                      const std::string first_line { lines.front() };
-                      const std::sregex_iterator it { first_line.begin(), first_line.end(), game_regex };
+    for (const auto line : lines | std::views::drop(1)) {
+        if (line.empty())
+            continue;
 
-                      result.from = it->str(1);
-                      result.to = it->str(2);
-                  }
+        if (const auto header = parse_mapping_header(line)) {
+            result.mappings.push_back({ .from = std::string { header->first }, .to = std::string { header->second }, .ranges = {} });
+            continue;
+        }
 
-                  for (const auto& line : lines | std::views::drop(1)) {
+        if (result.mappings.empty())
+            throw std::invalid_argument("range without mapping header");
 
-                      almanac::mapping::range source_range;
-                      size_t destination_start;
+        result.mappings.back().ranges.push_back(parse_range(line));
+    }
 
-                      std::ispanstream { line } >> destination_start >> source_range.start >> source_range.len;
-                      result.source_to_dest.insert({ source_range, destination_start });
-                  }
+    for (auto& mapping : result.mappings)
+        std::ranges::sort(mapping.ranges, std::less {}, &almanac::mapping::range::source_start);
 
-                  return result;
-              }) };
+    order_mapping_chain(result.mappings);
 
     return result;
 }
 
-size_t solve_for_seeds(auto&& seeds, const std::span<const almanac::mapping> mappings)
+// to be raised whenever the layout of the almanac_view changes, as it is stored as is in the snapshots
+constexpr uint32_t almanac_model_version = 1;
+
+almanac_view view_of(const quxflux::snapshot& model)
+{
+    return { .seeds = model.section<size_t>(0), .ranges = model.section<almanac::mapping::range>(1), .mapping_offsets = model.section<size_t>(2) };
+}
+
+// a snapshot read from disk is used without being parsed again, so its offsets have to stay within the ranges and
+// the ranges of every mapping have to be sorted for the binary search
+bool is_valid(const quxflux::snapshot& model)
+{
+    if (model.num_sections() != 3)
+        return false;
+
+    const auto almanac = view_of(model);
+    const auto& offsets = almanac.mapping_offsets;
+
+    if (offsets.empty() || offsets.front() != 0 || offsets.back() != almanac.ranges.size() || !std::ranges::is_sorted(offsets))
+        return false;
+
+    return std::ranges::all_of(offsets | std::views::pairwise, [&](const auto bounds) {
+        const auto [first, last] = bounds;
+        return std::ranges::is_sorted(almanac.ranges.subspan(first, last - first), std::less {}, &almanac::mapping::range::source_start);
+    });
+}
+
+quxflux::snapshot load_almanac()
+{
+    return quxflux::load_model(5, almanac_model_version, QUXFLUX_GET_INPUT(), [] {
+        const auto parsed = read_almanac();
+
+        std::vector<almanac::mapping::range> ranges;
+        std::vector<size_t> mapping_offsets { 0 };
+
+        for (const auto& mapping : parsed.mappings) {
+            ranges.insert(ranges.end(), mapping.ranges.begin(), mapping.ranges.end());
+            mapping_offsets.push_back(ranges.size());
+        }
+
+        quxflux::snapshot_writer writer;
+        writer.add(std::span<const size_t> { parsed.seeds }).add(std::span<const almanac::mapping::range> { ranges }).add(std::span<const size_t> { mapping_offsets });
+        return writer;
+    }, &is_valid);
+}
+
+size_t solve_for_seeds(auto&& seeds, const almanac_view& almanac)
 {
     constexpr auto min_f = [](const auto lhs, const auto rhs) { return std::min(lhs, rhs); };
-    return std::ranges::fold_left_first(seeds | std::views::transform([=](const auto seed) { return resolve_seed(mappings, seed); }), min_f).value();
+    return std::ranges::fold_left_first(seeds | std::views::transform([&](const auto seed) { return resolve_seed(almanac, seed); }), min_f).value();
 }
 
 size_t part_1()
 {
-    const auto almanac = read_almanac();
-    return solve_for_seeds(almanac.seeds, almanac.mappings);
+    const auto model = load_almanac();
+    const auto almanac = view_of(model);
+
+    const quxflux::allocation_phase phase("resolve seeds");
+    return solve_for_seeds(almanac.seeds, almanac);
 }
 
 size_t part_2()
 {
-    const auto almanac = read_almanac();
+    const auto model = load_almanac();
+    const auto almanac = view_of(model);
 
     auto seeds = almanac.seeds
         | std::views::chunk(2)
         | std::views::transform([](const auto idx_pair) { return std::views::iota(idx_pair.front(), idx_pair.front() + idx_pair.back()); })
         | std::views::join;
 
-    return solve_for_seeds(seeds, almanac.mappings);
+    const quxflux::allocation_phase phase("resolve seeds");
+    return solve_for_seeds(seeds, almanac);
 }
 
 } // namespace
 
-int main()
+int main(const int argc, char* argv[])
 {
-    std::cout << part_1() << '\n';
-    std::cout << part_2() << '\n';
-    return 0;
+    return quxflux::run_puzzle(5, &part_1, &part_2, QUXFLUX_INPUT_PATH(), argc, argv);
 }
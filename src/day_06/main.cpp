@@ -1,5 +1,15 @@
+#include <aoc23/driver.h>
 #include <aoc23/util.h>
 
+#include <cmath>
+#include <execution>
+#include <span>
+#include <stdexcept>
+
+#if !QUXFLUX_HAS_UINT128
+#error "day 6 requires a toolchain providing unsigned __int128"
+#endif
+
 namespace {
 
 struct race {
@@ -9,54 +19,169 @@ struct race {
     static constexpr size_t velocity = 1;
 };
 
-constexpr auto races = std::to_array<race>({
-    { .time = 48, .distance = 255 },
-    { .time = 87, .distance = 1288 },
-    { .time = 69, .distance = 1117 },
-    { .time = 81, .distance = 1623 },
-});
+std::pair<std::string_view, std::string_view> read_time_and_distance_lines()
+{
+    constexpr std::string_view time_prefix { "Time:" };
+    constexpr std::string_view distance_prefix { "Distance:" };
+
+    auto lines = QUXFLUX_GET_INPUT() | std::views::split('\n') | std::views::transform(quxflux::as_string_view);
+    auto it = lines.begin();
+
+    auto time_line = *it;
+    auto distance_line = *++it;
+
+    if (!time_line.starts_with(time_prefix) || !distance_line.starts_with(distance_prefix))
+        throw std::invalid_argument("malformed race sheet");
+
+    time_line.remove_prefix(time_prefix.size());
+    distance_line.remove_prefix(distance_prefix.size());
 
-constexpr auto calculate_min_max_winning_time(const race& r)
+    return { time_line, distance_line };
+}
+
+std::vector<race> read_races()
 {
-    const auto start_times = std::views::iota(size_t { 0 }, r.time);
+    auto [time_line, distance_line] = read_time_and_distance_lines();
+
+    std::vector<race> races;
 
-    const auto beats_distance = [&](const size_t start_time) {
-        const auto remaining_time = r.time - start_time;
+    while (const auto time = quxflux::consume_uint(time_line)) {
+        const auto distance = quxflux::consume_uint(distance_line);
 
-        if (remaining_time == 0)
-            return false;
+        if (!distance)
+            throw std::invalid_argument("race without distance");
+
+        races.push_back({ .time = *time, .distance = *distance });
+    }
+
+    return races;
+}
 
-        const auto v = start_time * r.velocity;
-        return remaining_time * v > r.distance;
+race read_race_ignoring_spaces()
+{
+    const auto [time_line, distance_line] = read_time_and_distance_lines();
+
+    constexpr auto concatenate_digits = [](const std::string_view line) {
+        return std::ranges::fold_left(line | std::views::filter(&quxflux::is_digit), size_t { 0 }, [](const size_t value, const char c) {
+            return value * 10 + static_cast<size_t>(c - '0');
+        });
     };
 
-    const auto min_wait_time = std::ranges::partition_point(start_times, std::not_fn(beats_distance));
-    const auto max_wait_time = std::ranges::partition_point(start_times, beats_distance);
+    return { .time = concatenate_digits(time_line), .distance = concatenate_digits(distance_line) };
+}
+
+constexpr quxflux::uint128 isqrt(quxflux::uint128 n)
+{
+    quxflux::uint128 result = 0;
+    quxflux::uint128 bit = quxflux::uint128 { 1 } << 126;
+
+    while (bit > n)
+        bit >>= 2;
 
-    return std::pair { *min_wait_time, *(max_wait_time - 1) };
+    while (bit != 0) {
+        if (n >= result + bit) {
+            n -= result + bit;
+            result = (result >> 1) + bit;
+        } else {
+            result >>= 1;
+        }
+
+        bit >>= 2;
+    }
+
+    return result;
 }
 
-constexpr auto get_num_winning_start_times(const race& r)
+constexpr bool beats_distance(const race& r, const size_t start_time)
 {
-    const auto [min, max] = calculate_min_max_winning_time(r);
-    return max - min + 1;
+    return quxflux::uint128 { start_time } * race::velocity * (r.time - start_time) > r.distance;
+}
+
+// the winning start times h satisfy h * (time - h) > distance, i.e. they lie strictly between the roots of
+// h^2 - time * h + distance; as the interval is symmetric around time / 2 only the lower bound needs to be found
+constexpr size_t get_num_winning_start_times(const race& r)
+{
+    const auto time_squared = quxflux::uint128 { r.time } * r.time;
+    const auto four_distance = quxflux::uint128 { r.distance } * 4;
+
+    if (time_squared <= four_distance)
+        return 0;
+
+    const auto root = static_cast<size_t>(isqrt(time_squared - four_distance));
+
+    // (time - root) / 2 is off by at most one from the smallest winning start time
+    auto min_start_time = (r.time - root) / 2;
+
+    while (min_start_time > 0 && beats_distance(r, min_start_time - 1))
+        --min_start_time;
+
+    while (min_start_time <= r.time / 2 && !beats_distance(r, min_start_time))
+        ++min_start_time;
+
+    if (min_start_time > r.time / 2)
+        return 0;
+
+    return r.time - 2 * min_start_time + 1;
+}
+
+// for these races all intermediates fit into 64 bit and a double precision root is accurate to +-1
+constexpr bool is_fast_path_applicable(const race& r)
+{
+    return r.time < (size_t { 1 } << 32) && r.distance < (size_t { 1 } << 62);
+}
+
+// branch free variant of get_num_winning_start_times for races satisfying is_fast_path_applicable
+size_t get_num_winning_start_times_fast(const race& r)
+{
+    const auto time_squared = r.time * r.time;
+    const auto four_distance = r.distance * 4;
+    const auto discriminant = time_squared > four_distance ? time_squared - four_distance : 0;
+
+    auto min_start_time = static_cast<size_t>((static_cast<double>(r.time) - std::sqrt(static_cast<double>(discriminant))) / 2);
+
+    const auto beats = [&](const size_t start_time) {
+        return start_time <= r.time && start_time * (r.time - start_time) > r.distance;
+    };
+
+    min_start_time -= min_start_time > 0 && beats(min_start_time - 1);
+    min_start_time += !beats(min_start_time);
+    min_start_time += !beats(min_start_time);
+
+    return 2 * min_start_time <= r.time ? r.time - 2 * min_start_time + 1 : 0;
+}
+
+// batch mode: solves all races with a vectorizable kernel and falls back to the exact 128 bit solver for races
+// exceeding its range
+void get_num_winning_start_times(const std::span<const race> races, const std::span<size_t> num_winning_start_times)
+{
+    if (races.size() != num_winning_start_times.size())
+        throw std::invalid_argument("output size mismatch");
+
+    std::transform(std::execution::par_unseq, races.begin(), races.end(), num_winning_start_times.begin(), &get_num_winning_start_times_fast);
+
+    for (const auto&& [r, n] : std::views::zip(races, num_winning_start_times))
+        if (!is_fast_path_applicable(r))
+            n = get_num_winning_start_times(r);
 }
 
 size_t part_1()
 {
-    return std::ranges::fold_left_first(races | std::views::transform(&get_num_winning_start_times), std::multiplies {}).value();
+    const auto races = read_races();
+
+    std::vector<size_t> num_winning_start_times(races.size());
+    get_num_winning_start_times(races, num_winning_start_times);
+
+    return std::ranges::fold_left_first(num_winning_start_times, std::multiplies {}).value();
 }
 
 size_t part_2()
 {
-    return get_num_winning_start_times({ .time = 48876981, .distance = 255128811171623 });
+    return get_num_winning_start_times(read_race_ignoring_spaces());
 }
 
 } // namespace
 
-int main()
+int main(const int argc, char* argv[])
 {
-    std::cout << part_1() << '\n';
-    std::cout << part_2() << '\n';
-    return 0;
+    return quxflux::run_puzzle(6, &part_1, &part_2, QUXFLUX_INPUT_PATH(), argc, argv);
 }
@@ -1,10 +1,26 @@
+#include <aoc23/allocation_stats.h>
+#include <aoc23/driver.h>
+#include <aoc23/fenwick_tree.h>
+#include <aoc23/line_source.h>
+#include <aoc23/radix_sort.h>
+#include <aoc23/snapshot.h>
 #include <aoc23/util.h>
 
+#include <bit>
+#include <cassert>
+#include <exception>
+#include <execution>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+#include <tuple>
 #include <utility>
 
 namespace {
 
-enum class card_label {
+enum class card_label : uint8_t {
     d2,
     d3,
     d4,
@@ -22,124 +38,470 @@ enum class card_label {
 
 constexpr size_t num_labels = 13;
 
-using hand = std::array<card_label, 5>;
+constexpr size_t hand_size = 5;
+
+using hand = std::array<card_label, hand_size>;
 
 constexpr card_label convert(const char c)
 {
     constexpr std::array vals { '2', '3', '4', '5', '6', '7', '8', '9', 'T', 'J', 'Q', 'K', 'A' };
-    return static_cast<card_label>(std::ranges::distance(vals.begin(), std::ranges::find(vals, c)));
-}
-
-constexpr std::array<uint8_t, num_labels> histogram(const hand& hand)
-{
-    std::array<uint8_t, num_labels> result {};
 
-    for (const auto t : hand)
-        result[std::to_underlying(t)]++;
+    const auto it = std::ranges::find(vals, c);
+    if (it == vals.end())
+        throw std::invalid_argument("invalid card label");
 
-    return result;
+    return static_cast<card_label>(std::ranges::distance(vals.begin(), it));
 }
 
-enum class special_rules {
-    none,
-    joker
+// group sizes of the hand's non wild cards along with the number of wild cards
+struct hand_shape {
+    // num_groups[n] is the number of distinct non wild labels occurring exactly n times
+    uint8_t num_groups[hand_size + 1] {};
+    uint8_t num_wild = 0;
+};
+
+// a rule set names its (optional) wild card and maps a hand shape to one of num_categories strengths,
+// a greater strength beating a lower one
+template <typename T>
+concept rule_set = requires(const hand_shape& shape) {
+    { T::wild_card } -> std::convertible_to<std::optional<card_label>>;
+    { T::num_categories } -> std::convertible_to<size_t>;
+    { T::categorize(shape) } -> std::same_as<uint8_t>;
 };
 
-template <special_rules Rules>
-constexpr uint8_t hand_strength(const hand& hand)
+// sizes of the largest and the second largest group of non wild cards
+constexpr std::pair<uint8_t, uint8_t> two_largest_groups(const hand_shape& shape)
 {
-    auto [hist, num_jokers] = [&] {
-        auto t = histogram(hand);
+    std::array<uint8_t, 2> result {};
+    auto out = result.begin();
 
-        if constexpr (Rules == special_rules::joker) {
-            std::array<uint8_t, num_labels - 1> hist_without_joker {};
-            std::ranges::copy(std::span { t }.subspan(0, 9), hist_without_joker.begin());
-            std::ranges::copy(std::span { t }.subspan(10), hist_without_joker.begin() + 9);
+    for (uint8_t size = hand_size; size > 0 && out != result.end(); --size)
+        for (uint8_t i = 0; i < shape.num_groups[size] && out != result.end(); ++i)
+            *out++ = size;
 
-            return std::pair { hist_without_joker, t[std::to_underlying(card_label::J)] };
-        } else {
-            return std::pair { t, uint8_t { 0 } };
-        }
-    }();
-    std::ranges::sort(hist, std::greater {});
+    return { result[0], result[1] };
+}
 
-    if (const bool is_five_of_a_kind = hist[0] + num_jokers == 5)
+constexpr uint8_t classic_category(const hand_shape& shape)
+{
+    const auto [largest_without_wild, second] = two_largest_groups(shape);
+    const auto largest = largest_without_wild + shape.num_wild;
+
+    if (const bool is_five_of_a_kind = largest == 5)
         return 6;
-    if (const bool is_four_of_a_kind = hist[0] + num_jokers == 4)
+    if (const bool is_four_of_a_kind = largest == 4)
         return 5;
-    if (const bool is_full_house = hist[0] + num_jokers == 3 && hist[1] == 2)
+    if (const bool is_full_house = largest == 3 && second == 2)
         return 4;
-    if (const bool is_three_of_a_kind = hist[0] + num_jokers == 3)
+    if (const bool is_three_of_a_kind = largest == 3)
         return 3;
-    if (const bool is_two_pair = hist[0] + num_jokers == 2 && hist[1] == 2)
+    if (const bool is_two_pair = largest == 2 && second == 2)
         return 2;
-    if (const bool is_one_pair = hist[0] + num_jokers == 2)
+    if (const bool is_one_pair = largest == 2)
         return 1;
 
     return 0;
 }
 
-template <special_rules Rules>
-constexpr bool compare_hands(const hand& lhs, const hand& rhs)
+struct standard_rules {
+    static constexpr std::optional<card_label> wild_card = std::nullopt;
+    static constexpr size_t num_categories = 7;
+    static constexpr uint8_t categorize(const hand_shape& shape) { return classic_category(shape); }
+};
+
+struct joker_rules {
+    static constexpr std::optional<card_label> wild_card = card_label::J;
+    static constexpr size_t num_categories = 7;
+    static constexpr uint8_t categorize(const hand_shape& shape) { return classic_category(shape); }
+};
+
+constexpr size_t num_hands = [] {
+    size_t n = 1;
+    for (size_t i = 0; i < hand_size; ++i)
+        n *= num_labels;
+    return n;
+}();
+
+// base 13 encoding of a hand, first card most significant
+constexpr size_t hand_code(const hand& hand)
+{
+    return std::ranges::fold_left(hand, size_t { 0 }, [](const size_t code, const card_label l) { return code * num_labels + std::to_underlying(l); });
+}
+
+template <rule_set Rules>
+struct strength_table_t {
+    uint8_t strength[num_hands];
+};
+
+template <rule_set Rules>
+constexpr size_t wild_index = Rules::wild_card.has_value() ? std::to_underlying(*Rules::wild_card) : num_labels;
+
+// dense index of a shape; there are at most hand_size / n groups of size n
+constexpr size_t shape_index(const hand_shape& shape)
 {
-    const auto lhs_strength = hand_strength<Rules>(lhs);
-    const auto rhs_strength = hand_strength<Rules>(rhs);
+    size_t index = shape.num_wild;
+    for (size_t size = hand_size; size > 0; --size)
+        index = index * (hand_size / size + 1) + shape.num_groups[size];
+    return index;
+}
+
+constexpr size_t num_shape_indices = [] {
+    size_t n = hand_size + 1;
+    for (size_t size = 1; size <= hand_size; ++size)
+        n *= hand_size / size + 1;
+    return n;
+}();
+
+// hands are enumerated depth first in the order of their code while the shape is kept up to date card by card and
+// categorized once per distinct shape; evaluating every hand from scratch exceeds the compilers' constexpr
+// evaluation limits (plain arrays are used as they are considerably cheaper to evaluate than std::array)
+template <rule_set Rules>
+struct strength_table_builder {
+    static constexpr size_t wild = wild_index<Rules>;
+    static constexpr uint8_t uncategorized = 0xff;
+
+    strength_table_t<Rules> table {};
+    uint8_t category_cache[num_shape_indices] {};
+    uint8_t hist[num_labels] {};
+    hand_shape shape {};
+    size_t code = 0;
+
+    constexpr strength_table_builder()
+    {
+        std::ranges::fill(category_cache, uncategorized);
+        shape.num_groups[0] = num_labels - (wild < num_labels ? 1 : 0);
+    }
 
-    if (lhs_strength != rhs_strength)
-        return lhs_strength < rhs_strength;
+    constexpr uint8_t category()
+    {
+        auto& cached = category_cache[shape_index(shape)];
+        if (cached == uncategorized)
+            cached = Rules::categorize(shape);
+        return cached;
+    }
 
-    constexpr auto card_strength = [](const card_label l) {
-        if constexpr (Rules == special_rules::joker) {
-            if (l == card_label::J)
-                return -1;
+    constexpr void fill(const size_t num_cards)
+    {
+        if (num_cards + 1 < hand_size) {
+            for (size_t l = 0; l < num_labels; ++l) {
+                if (l == wild) {
+                    ++shape.num_wild;
+                    fill(num_cards + 1);
+                    --shape.num_wild;
+                } else {
+                    --shape.num_groups[hist[l]];
+                    ++shape.num_groups[++hist[l]];
+                    fill(num_cards + 1);
+                    --shape.num_groups[hist[l]];
+                    ++shape.num_groups[--hist[l]];
+                }
+            }
+            return;
         }
 
-        return std::to_underlying(l);
-    };
+        // the last card only matters through the size of the group it joins; index hand_size stands for the wild card
+        uint8_t category_by_group_size[hand_size + 1] {};
+        for (size_t size = 0; size < hand_size; ++size) {
+            if (shape.num_groups[size] == 0)
+                continue;
 
-    const auto zipped = std::views::zip(lhs, rhs);
-    const auto idx = std::ranges::distance(zipped.begin(), std::ranges::find_if(zipped, [](const auto labels) { return std::apply(std::not_equal_to {}, labels); }));
+            --shape.num_groups[size];
+            ++shape.num_groups[size + 1];
+            category_by_group_size[size] = category();
+            ++shape.num_groups[size];
+            --shape.num_groups[size + 1];
+        }
+
+        if constexpr (wild < num_labels) {
+            ++shape.num_wild;
+            category_by_group_size[hand_size] = category();
+            --shape.num_wild;
+        }
+
+        for (size_t l = 0; l < num_labels; ++l)
+            table.strength[code++] = category_by_group_size[l == wild ? hand_size : hist[l]];
+    }
+};
+
+template <rule_set Rules>
+constexpr strength_table_t<Rules> make_strength_table()
+{
+    strength_table_builder<Rules> builder;
+    builder.fill(0);
+    return builder.table;
+}
+
+// strength of every possible hand indexed by its hand_code, evaluated at compile time
+template <rule_set Rules>
+constexpr strength_table_t<Rules> strength_table = make_strength_table<Rules>();
+
+template <rule_set Rules>
+constexpr uint8_t card_rank(const card_label l)
+{
+    if constexpr (Rules::wild_card.has_value()) {
+        if (l == *Rules::wild_card)
+            return 0;
+    }
+
+    return std::to_underlying(l) + 1;
+}
+
+using hand_key = uint32_t;
 
-    return card_strength(lhs[idx]) < card_strength(rhs[idx]);
+constexpr unsigned card_rank_bits = 4;
+
+template <rule_set Rules>
+constexpr unsigned hand_key_bits = std::bit_width(Rules::num_categories - 1) + hand_size * card_rank_bits;
+
+static_assert(hand_key_bits<standard_rules> <= std::numeric_limits<hand_key>::digits);
+static_assert(hand_key_bits<joker_rules> <= std::numeric_limits<hand_key>::digits);
+
+// packs the hand strength into the highest bits followed by the card ranks in order, so that
+// ordering the keys orders the hands
+template <rule_set Rules>
+constexpr hand_key make_key(const hand& hand)
+{
+    hand_key key = strength_table<Rules>.strength[hand_code(hand)];
+
+    for (const auto label : hand)
+        key = (key << card_rank_bits) | card_rank<Rules>(label);
+
+    return key;
 }
 
-auto read_input()
+// ordinal of every label among all labels ordered by card_rank
+template <rule_set Rules>
+constexpr auto card_ordinal = [] {
+    std::array<uint8_t, num_labels> ordinals {};
+    for (size_t l = 0; l < num_labels; ++l)
+        for (size_t other = 0; other < num_labels; ++other)
+            ordinals[l] += card_rank<Rules>(static_cast<card_label>(other)) < card_rank<Rules>(static_cast<card_label>(l));
+    return ordinals;
+}();
+
+template <rule_set Rules>
+constexpr size_t num_dense_keys = Rules::num_categories * num_hands;
+
+// orders the hands like make_key but without gaps between the keys: the strength followed by the base 13 card ordinals
+template <rule_set Rules>
+constexpr size_t make_dense_key(const hand& hand)
 {
-    return std::vector { std::from_range, QUXFLUX_GET_INPUT() | std::views::split('\n') | std::views::transform(quxflux::as_string_view) | std::views::transform([](const std::string_view line) {
-                            hand h;
-                            std::ranges::transform(line.substr(0, 5), h.begin(), &convert);
-                            return std::pair { h, std::stoul(std::string { line.substr(6) }) };
-                        }) };
+    return std::ranges::fold_left(hand, size_t { strength_table<Rules>.strength[hand_code(hand)] }, [](const size_t key, const card_label l) {
+        return key * num_labels + card_ordinal<Rules>[std::to_underlying(l)];
+    });
 }
 
-template <special_rules Rules>
+// total winnings of a stream of hands, available after every hand: inserting a hand raises the rank of every stronger
+// hand by one, so the total grows by their bids plus the new hand's own rank times its bid; both are prefix sums over
+// the dense keys. equal hands are ranked in insertion order, as the stable sort in calculate does
+template <rule_set Rules>
+class streaming_winnings {
+public:
+    streaming_winnings()
+        : num_hands_(num_dense_keys<Rules>)
+        , bids_(num_dense_keys<Rules>)
+    {
+    }
+
+    void insert(const hand& hand, const size_t bid)
+    {
+        const auto key = make_dense_key<Rules>(hand);
+
+        const auto num_weaker_or_equal = num_hands_.prefix_sum(key + 1);
+        const auto bids_of_stronger = total_bid_ - bids_.prefix_sum(key + 1);
+
+        total_winnings_ += bids_of_stronger + (num_weaker_or_equal + 1) * bid;
+        total_bid_ += bid;
+
+        num_hands_.add(key, 1);
+        bids_.add(key, bid);
+    }
+
+    [[nodiscard]] size_t total_winnings() const { return total_winnings_; }
+
+private:
+    quxflux::fenwick_tree<uint32_t> num_hands_;
+    quxflux::fenwick_tree<size_t> bids_;
+    size_t total_bid_ = 0;
+    size_t total_winnings_ = 0;
+};
+
+// structure of arrays holding the hands and their bids
+struct hand_list {
+    std::vector<hand> hands;
+    std::vector<size_t> bids;
+};
+
+std::pair<hand, size_t> parse_hand(std::string_view line)
+{
+    if (line.size() < hand_size)
+        throw std::invalid_argument("incomplete hand");
+
+    hand h;
+    std::ranges::transform(line.substr(0, hand_size), h.begin(), &convert);
+    line.remove_prefix(hand_size);
+
+    const auto bid = quxflux::consume_uint(line);
+    if (!bid)
+        throw std::invalid_argument("hand without bid");
+
+    return { h, *bid };
+}
+
+constexpr size_t count_lines(const std::string_view str)
+{
+    return std::ranges::count(str, '\n') + (!str.empty() && str.back() != '\n');
+}
+
+// parses line aligned chunks of the input concurrently: the lines of every chunk are counted first to know where
+// the chunk's hands are to be stored, afterwards each chunk is parsed into its slots. an exception escaping a parallel
+// algorithm terminates the program, so the first error of every chunk is kept and rethrown afterwards
+hand_list read_input()
+{
+    constexpr size_t min_chunk_size = 1 << 20;
+
+    const auto input = QUXFLUX_GET_INPUT();
+    const auto chunks = quxflux::split_into_line_chunks(input, quxflux::num_parallel_chunks(input.size(), min_chunk_size));
+
+    std::vector<size_t> first_line_of_chunk(chunks.size());
+    std::transform(std::execution::par, chunks.begin(), chunks.end(), first_line_of_chunk.begin(), &count_lines);
+    std::exclusive_scan(first_line_of_chunk.begin(), first_line_of_chunk.end(), first_line_of_chunk.begin(), size_t { 0 });
+
+    const size_t num_lines = chunks.empty() ? 0 : first_line_of_chunk.back() + count_lines(chunks.back());
+
+    hand_list result { .hands = std::vector<hand>(num_lines), .bids = std::vector<size_t>(num_lines) };
+
+    const std::vector chunk_indices { std::from_range, std::views::iota(size_t { 0 }, chunks.size()) };
+
+    std::vector<std::exception_ptr> errors(chunks.size());
+
+    std::for_each(std::execution::par, chunk_indices.begin(), chunk_indices.end(), [&](const size_t chunk) {
+        auto line_idx = first_line_of_chunk[chunk];
+
+        try {
+            for (auto rest = chunks[chunk]; !rest.empty(); ++line_idx) {
+                const auto line_end = rest.find('\n');
+                std::tie(result.hands[line_idx], result.bids[line_idx]) = parse_hand(rest.substr(0, line_end));
+                rest.remove_prefix(line_end == std::string_view::npos ? rest.size() : line_end + 1);
+            }
+        } catch (...) {
+            errors[chunk] = std::current_exception();
+        }
+    });
+
+    for (const auto& error : errors)
+        if (error)
+            std::rethrow_exception(error);
+
+    return result;
+}
+
+// to be raised whenever the layout of hand changes, as it is stored as is in the snapshots
+constexpr uint32_t hand_list_model_version = 2;
+
+// hands and bids of the input, used in place from the snapshot owning them
+struct hand_list_view {
+    std::span<const hand> hands;
+    std::span<const size_t> bids;
+};
+
+hand_list_view view_of(const quxflux::snapshot& model)
+{
+    return { .hands = model.section<hand>(0), .bids = model.section<size_t>(1) };
+}
+
+// a snapshot read from disk is used without being parsed again, so any label outside of card_label is rejected
+bool is_valid(const quxflux::snapshot& model)
+{
+    if (model.num_sections() != 2)
+        return false;
+
+    const auto [hands, bids] = view_of(model);
+    return hands.size() == bids.size() && std::ranges::all_of(hands | std::views::join, [](const card_label l) { return std::to_underlying(l) < num_labels; });
+}
+
+quxflux::snapshot load_input()
+{
+    return quxflux::load_model(7, hand_list_model_version, QUXFLUX_GET_INPUT(), [] {
+        const auto parsed = read_input();
+        quxflux::snapshot_writer writer;
+        writer.add(std::span<const hand> { parsed.hands }).add(std::span<const size_t> { parsed.bids });
+        return writer;
+    }, &is_valid);
+}
+
+// hands arriving on a stream (--stream) are ranked as they come in, the running total winnings are printed after every
+// hand; memory stays constant however many hands there are
+template <rule_set Rules>
+size_t calculate_streamed()
+{
+    streaming_winnings<Rules> winnings;
+
+    for (const auto line : QUXFLUX_GET_INPUT_LINES()) {
+        const auto [h, bid] = parse_hand(line);
+        winnings.insert(h, bid);
+        std::cout << winnings.total_winnings() << '\n' << std::flush;
+    }
+
+    return winnings.total_winnings();
+}
+
+template <rule_set Rules>
 size_t calculate()
 {
-    auto data = read_input();
-    std::ranges::sort(data, &compare_hands<Rules>, [](const auto& p) { return p.first; });
+    if (quxflux::input_is_streamed())
+        return calculate_streamed<Rules>();
 
-    return std::ranges::fold_left(std::views::enumerate(data | std::views::elements<1>) | std::views::transform([](const auto rank_and_bid) {
-        const auto [rank, bid] = rank_and_bid;
-        return (rank + 1) * bid;
-    }),
-        size_t { 0 }, std::plus {});
+    const auto model = load_input();
+    const auto input = view_of(model);
+    const auto& hands = input.hands;
+
+    // the bids in the order of the strength of their hands
+    const auto bids = [&] {
+        const quxflux::allocation_phase phase("sort hands");
+
+        std::vector sorted_bids { std::from_range, input.bids };
+        std::vector<hand_key> keys(hands.size());
+        std::transform(std::execution::par_unseq, hands.begin(), hands.end(), keys.begin(), &make_key<Rules>);
+        quxflux::radix_sort(std::execution::par, keys, std::span { sorted_bids }, hand_key_bits<Rules>);
+        return sorted_bids;
+    }();
+
+    const quxflux::allocation_phase phase("sum winnings");
+
+    constexpr size_t min_chunk_size = 1 << 16;
+    const auto chunks = quxflux::chunk_ranges(bids.size(), quxflux::num_parallel_chunks(bids.size(), min_chunk_size));
+
+    const auto total_winnings = std::transform_reduce(std::execution::par, chunks.begin(), chunks.end(), size_t { 0 }, std::plus {}, [&](const std::pair<size_t, size_t>& chunk) {
+        size_t sum = 0;
+        for (size_t rank = chunk.first; rank < chunk.second; ++rank)
+            sum += (rank + 1) * bids[rank];
+        return sum;
+    });
+
+    assert(([&] {
+        streaming_winnings<Rules> streaming;
+        for (const auto& [h, bid] : std::views::zip(input.hands, input.bids))
+            streaming.insert(h, bid);
+        return streaming.total_winnings() == total_winnings;
+    }()));
+
+    return total_winnings;
 }
 
 size_t part_1()
 {
-    return calculate<special_rules::none>();
+    return calculate<standard_rules>();
 }
 
 size_t part_2()
 {
-    return calculate<special_rules::joker>();
+    return calculate<joker_rules>();
 }
 
 } // namespace
 
-int main()
+int main(const int argc, char* argv[])
 {
-    std::cout << part_1() << '\n';
-    std::cout << part_2() << '\n';
-    return 0;
+    return quxflux::run_puzzle(7, &part_1, &part_2, QUXFLUX_INPUT_PATH(), argc, argv);
 }
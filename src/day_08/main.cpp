@@ -1,8 +1,24 @@
+#include <aoc23/allocation_stats.h>
+#include <aoc23/driver.h>
+#include <aoc23/snapshot.h>
 #include <aoc23/util.h>
 
+#include <bit>
 #include <cassert>
-#include <map>
+#include <cstdint>
+#include <execution>
+#include <functional>
+#include <limits>
 #include <numeric>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+#if !QUXFLUX_HAS_UINT128
+#error "day 8 requires a toolchain providing unsigned __int128"
+#endif
 
 namespace {
 
@@ -20,11 +36,61 @@ struct hasher {
     }
 };
 
-auto read_input()
+using node_id = uint32_t;
+
+// the L/R pattern as one bit per instruction, set for R
+struct instructions {
+    std::span<const uint64_t> bits;
+    size_t size = 0;
+
+    [[nodiscard]] constexpr bool is_right(const size_t i) const { return (bits[i / 64] >> (i % 64)) & 1; }
+};
+
+// the network compiled into dense node ids; next[id] holds the ids of the left and right successor
+struct network {
+    std::span<const node_name> names;
+    std::span<const std::array<node_id, 2>> next;
+
+    [[nodiscard]] node_id id_of(const node_name& name) const
+    {
+        const auto it = std::ranges::find(names, name);
+        if (it == names.end())
+            throw std::invalid_argument("unknown node");
+
+        return static_cast<node_id>(std::ranges::distance(names.begin(), it));
+    }
+};
+
+constexpr size_t num_instruction_words(const size_t num_instructions)
+{
+    return (num_instructions + 63) / 64;
+}
+
+// the bits of the instructions of the pattern
+std::vector<uint64_t> compile_instructions(const std::string_view pattern)
+{
+    if (pattern.empty())
+        throw std::invalid_argument("empty instruction pattern");
+
+    std::vector<uint64_t> result(num_instruction_words(pattern.size()));
+
+    for (const auto [i, dir] : std::views::enumerate(pattern)) {
+        if (dir != 'L' && dir != 'R')
+            throw std::invalid_argument("invalid instruction");
+
+        result[i / 64] |= uint64_t { dir == 'R' } << (i % 64);
+    }
+
+    return result;
+}
+
+// parses the input into the sections of the model: the pattern's size, its bits, the node names and their successors
+quxflux::snapshot_writer parse_input()
 {
     auto lines = QUXFLUX_GET_INPUT() | std::views::split('\n') | std::views::transform(quxflux::as_string_view);
 
-    const std::string pattern { lines.front() };
+    const auto pattern = lines.front();
+    const auto pattern_bits = compile_instructions(pattern);
 
     constexpr auto parse = [](std::string_view line) -> std::pair<node_name, junction> {
         node_name node;
@@ -38,68 +104,531 @@ auto read_input()
         return { node, { left, right } };
     };
 
-    return std::pair { pattern, std::map<node_name, junction> { std::from_range, lines | std::views::drop(2) | std::views::transform(parse) } };
+    const std::vector junctions { std::from_range, lines | std::views::drop(2) | std::views::filter([](const std::string_view line) { return !line.empty(); }) | std::views::transform(parse) };
+
+    std::vector<node_name> names;
+    std::vector<std::array<node_id, 2>> next;
+    names.reserve(junctions.size());
+    next.reserve(junctions.size());
+
+    std::unordered_map<node_name, node_id, hasher> ids;
+    ids.reserve(junctions.size());
+
+    for (const auto& [name, _] : junctions) {
+        if (!ids.emplace(name, static_cast<node_id>(names.size())).second)
+            throw std::invalid_argument("duplicate node");
+
+        names.push_back(name);
+    }
+
+    const auto lookup = [&](const node_name& name) {
+        const auto it = ids.find(name);
+        if (it == ids.end())
+            throw std::invalid_argument("unknown node");
+
+        return it->second;
+    };
+
+    for (const auto& [_, j] : junctions)
+        next.push_back({ lookup(j.left), lookup(j.right) });
+
+    const size_t pattern_size = pattern.size();
+
+    quxflux::snapshot_writer writer;
+    writer.add(std::span { &pattern_size, 1 }).add(std::span<const uint64_t> { pattern_bits }).add(std::span<const node_name> { names }).add(std::span<const std::array<node_id, 2>> { next });
+    return writer;
 }
 
-size_t calculate_num_steps_required(const auto& pattern, const auto& map, const node_name& from, const auto& reached_end)
+// to be raised whenever the layout of the sections written by parse_input changes, as they are stored as is in the snapshots
+constexpr uint32_t network_model_version = 1;
+
+// the pattern and the network, used in place from the snapshot owning them
+std::pair<instructions, network> view_of(const quxflux::snapshot& model)
 {
-    node_name current_node = from;
-    size_t num_steps = 0;
+    return { { .bits = model.section<uint64_t>(1), .size = model.section<size_t>(0)[0] }, { .names = model.section<node_name>(2), .next = model.section<std::array<node_id, 2>>(3) } };
+}
 
-    for (auto dir : std::views::repeat(pattern) | std::views::join) {
-        const auto [left, right] = map.at(current_node);
-        current_node = dir == 'L' ? left : right;
-        ++num_steps;
+// a snapshot read from disk is used without being parsed again, so every successor has to be a node of the network
+bool is_valid(const quxflux::snapshot& model)
+{
+    if (model.num_sections() != 4 || model.section<size_t>(0).size() != 1)
+        return false;
+
+    const auto [pattern, net] = view_of(model);
+
+    return pattern.size != 0 && pattern.bits.size() == num_instruction_words(pattern.size) && net.names.size() == net.next.size() &&
+        std::ranges::all_of(net.next | std::views::join, [&](const node_id id) { return id < net.names.size(); });
+}
 
-        if (reached_end(current_node))
-            return num_steps;
+quxflux::snapshot read_input()
+{
+    return quxflux::load_model(8, network_model_version, QUXFLUX_GET_INPUT(), &parse_input, &is_valid);
+}
+
+// marks the nodes satisfying pred
+std::vector<uint8_t> mark_nodes(const network& net, const auto& pred)
+{
+    return std::vector { std::from_range, net.names | std::views::transform([&](const node_name& name) { return uint8_t { pred(name) }; }) };
+}
+
+// follows the pattern from its beginning for num_steps steps
+node_id walk(const instructions& pattern, const network& net, node_id node, const size_t num_steps)
+{
+    for (size_t instruction = 0; instruction < num_steps; ++instruction)
+        node = net.next[node][pattern.is_right(instruction % pattern.size)];
+
+    return node;
+}
+
+// the node reached after following the complete pattern once, along with the first step of the pass reaching an
+// end node (0 if there is none)
+struct pattern_pass {
+    node_id last = 0;
+    size_t first_end_step = 0;
+};
+
+pattern_pass follow_pattern_once(const instructions& pattern, const network& net, node_id node, const std::span<const uint8_t> is_end)
+{
+    pattern_pass pass;
+
+    for (size_t instruction = 0; instruction < pattern.size; ++instruction) {
+        node = net.next[node][pattern.is_right(instruction)];
+
+        if (pass.first_end_step == 0 && is_end[node])
+            pass.first_end_step = instruction + 1;
     }
 
-    std::unreachable();
+    pass.last = node;
+    return pass;
 }
 
-size_t calculate_least_common_multiple(const std::span<const size_t> nums)
+// binary lifting over complete pattern passes: jump[k][node] is the node reached after 2^k passes and
+// reaches_end[k][node] tells whether an end node is reached on the way
+struct pass_jump_table {
+    size_t pattern_size = 0;
+    std::vector<pattern_pass> passes;
+    std::vector<std::vector<node_id>> jump;
+    std::vector<std::vector<uint8_t>> reaches_end;
+};
+
+// the table allows jumps over up to max_num_passes complete passes (at least one)
+pass_jump_table build_pass_jump_table(const instructions& pattern, const network& net, const std::span<const uint8_t> is_end, const size_t max_num_passes)
 {
-    std::vector<size_t> current_values { std::from_range, nums };
-    std::ranges::sort(current_values);
+    const size_t num_nodes = net.next.size();
+    const std::vector node_ids { std::from_range, std::views::iota(node_id { 0 }, static_cast<node_id>(num_nodes)) };
+
+    pass_jump_table table { .pattern_size = pattern.size, .passes = std::vector<pattern_pass>(num_nodes), .jump = {}, .reaches_end = {} };
+
+    std::transform(std::execution::par, node_ids.begin(), node_ids.end(), table.passes.begin(), [&](const node_id node) {
+        return follow_pattern_once(pattern, net, node, is_end);
+    });
 
-    return std::ranges::fold_left_first(current_values | std::views::reverse, [](const size_t lhs, const size_t rhs) {
-        return std::lcm(lhs, rhs);
-    }).value();
+    table.jump.push_back(std::vector<node_id> { std::from_range, table.passes | std::views::transform(&pattern_pass::last) });
+    table.reaches_end.push_back(std::vector<uint8_t> { std::from_range, table.passes | std::views::transform([](const pattern_pass& pass) { return uint8_t { pass.first_end_step != 0 }; }) });
+
+    const auto num_levels = std::bit_width(max_num_passes);
+
+    for (size_t level = 1; level < num_levels; ++level) {
+        const auto& prev_jump = table.jump.back();
+        const auto& prev_reaches_end = table.reaches_end.back();
+
+        std::vector<node_id> jump(num_nodes);
+        std::vector<uint8_t> reaches_end(num_nodes);
+
+        std::for_each(std::execution::par, node_ids.begin(), node_ids.end(), [&](const node_id node) {
+            const auto half_way = prev_jump[node];
+            jump[node] = prev_jump[half_way];
+            reaches_end[node] = prev_reaches_end[node] || prev_reaches_end[half_way];
+        });
+
+        table.jump.push_back(std::move(jump));
+        table.reaches_end.push_back(std::move(reaches_end));
+    }
+
+    return table;
 }
 
+// node reached after num_steps steps starting at the beginning of the pattern
+node_id position_after(const pass_jump_table& table, const instructions& pattern, const network& net, node_id node, const size_t num_steps)
+{
+    const size_t num_passes = num_steps / table.pattern_size;
+
+    if (std::bit_width(num_passes) > table.jump.size())
+        throw std::out_of_range("number of steps exceeds the jump table");
+
+    for (size_t level = 0; level < table.jump.size(); ++level)
+        if ((num_passes >> level) & 1)
+            node = table.jump[level][node];
+
+    return walk(pattern, net, node, num_steps % table.pattern_size);
+}
+
+// number of steps from node to the first end node, if one is reached within the range of the table
+std::optional<size_t> num_steps_until_end(const pass_jump_table& table, node_id node)
+{
+    size_t num_passes = 0;
+
+    // skip as many passes as possible without reaching an end node, the following pass reaches one if any is reachable
+    for (size_t level = table.jump.size(); level-- > 0;) {
+        if (!table.reaches_end[level][node]) {
+            node = table.jump[level][node];
+            num_passes += size_t { 1 } << level;
+        }
+    }
+
+    if (table.passes[node].first_end_step == 0)
+        return std::nullopt;
+
+    return num_passes * table.pattern_size + table.passes[node].first_end_step;
+}
+
+// steps at which a ghost is at an end node: every step in transient_hits and, from step cycle_start on, every step s
+// with s = r (mod period) for an r in cycle_hits (both sorted, cycle_hits lying in (cycle_start, cycle_start + period])
+struct ghost_cycle {
+    size_t cycle_start = 0;
+    size_t period = 0;
+    std::vector<size_t> transient_hits;
+    std::vector<size_t> cycle_hits;
+};
+
+// walks complete pattern passes until a pass starts at an already visited node; only passes reaching an end node are
+// walked instruction by instruction, any other pass is a single lookup of its last node in the pass table
+ghost_cycle detect_cycle(const pass_jump_table& table, const instructions& pattern, const network& net, node_id node, const std::span<const uint8_t> is_end)
+{
+    constexpr auto unvisited = std::numeric_limits<size_t>::max();
+    std::vector<size_t> first_visiting_pass(net.next.size(), unvisited);
+    std::vector<size_t> hits;
+
+    size_t pass = 0;
+    for (; first_visiting_pass[node] == unvisited; ++pass) {
+        first_visiting_pass[node] = pass;
+
+        if (table.passes[node].first_end_step != 0) {
+            node_id current = node;
+
+            for (size_t instruction = 0; instruction < pattern.size; ++instruction) {
+                current = net.next[current][pattern.is_right(instruction)];
+
+                if (is_end[current])
+                    hits.push_back(pass * pattern.size + instruction + 1);
+            }
+        }
+
+        node = table.passes[node].last;
+    }
+
+    ghost_cycle result { .cycle_start = first_visiting_pass[node] * pattern.size, .period = (pass - first_visiting_pass[node]) * pattern.size, .transient_hits = {}, .cycle_hits = {} };
+
+    const auto first_cycle_hit = std::ranges::upper_bound(hits, result.cycle_start);
+    result.transient_hits.assign(hits.begin(), first_cycle_hit);
+    result.cycle_hits.assign(first_cycle_hit, hits.end());
+
+    return result;
+}
+
+bool is_hit(const ghost_cycle& ghost, const size_t step)
+{
+    if (step <= ghost.cycle_start)
+        return std::ranges::binary_search(ghost.transient_hits, step);
+
+    return std::ranges::binary_search(ghost.cycle_hits, ghost.cycle_start + 1 + (step - ghost.cycle_start - 1) % ghost.period);
+}
+
+struct congruence {
+    size_t remainder = 0;
+    size_t modulus = 1;
+};
+
+// inverse of a modulo m for coprime a and m (m < 2^63)
+size_t modular_inverse(const size_t a, const size_t m)
+{
+    int64_t old_r = static_cast<int64_t>(a), r = static_cast<int64_t>(m);
+    int64_t old_s = 1, s = 0;
+
+    while (r != 0) {
+        const auto q = old_r / r;
+        old_r = std::exchange(r, old_r - q * r);
+        old_s = std::exchange(s, old_s - q * s);
+    }
+
+    const auto signed_m = static_cast<int64_t>(m);
+    return static_cast<size_t>((old_s % signed_m + signed_m) % signed_m);
+}
+
+// generalised chinese remainder theorem for moduli which need not be coprime
+std::optional<congruence> combine(const congruence& lhs, const congruence& rhs)
+{
+    const auto g = std::gcd(lhs.modulus, rhs.modulus);
+    const auto difference = (rhs.remainder % rhs.modulus + rhs.modulus - lhs.remainder % rhs.modulus) % rhs.modulus;
+
+    if (difference % g != 0)
+        return std::nullopt;
+
+    const auto reduced_modulus = rhs.modulus / g;
+    const auto lcm = quxflux::uint128 { lhs.modulus } * reduced_modulus;
+
+    if (lcm > std::numeric_limits<size_t>::max())
+        throw std::overflow_error("combined period exceeds 64 bit");
+
+    const auto k = quxflux::uint128 { difference / g } * modular_inverse(lhs.modulus / g % reduced_modulus, reduced_modulus) % reduced_modulus;
+
+    return congruence { .remainder = static_cast<size_t>((lhs.remainder + quxflux::uint128 { lhs.modulus } * k) % lcm), .modulus = static_cast<size_t>(lcm) };
+}
+
+// bound on the congruence systems kept while folding in the ghosts
+constexpr size_t max_num_congruence_systems = size_t { 1 } << 16;
+
+// smallest step at which all ghosts are at an end node at the same time
+std::optional<size_t> first_common_hit(const std::span<const ghost_cycle> ghosts)
+{
+    if (ghosts.empty())
+        return std::nullopt;
+
+    // from min_cyclic_step on every ghost is on its cycle, earlier common hits are searched among the first ghost's hits
+    const auto min_cyclic_step = std::ranges::max(ghosts | std::views::transform(&ghost_cycle::cycle_start)) + 1;
+    const auto is_common_hit = [&](const size_t step) { return std::ranges::all_of(ghosts, [&](const ghost_cycle& g) { return is_hit(g, step); }); };
+
+    const auto& first = ghosts.front();
+
+    for (const auto step : first.transient_hits)
+        if (step < min_cyclic_step && is_common_hit(step))
+            return step;
+
+    for (size_t period_start = 0; !first.cycle_hits.empty() && first.cycle_hits.front() + period_start < min_cyclic_step; period_start += first.period)
+        for (const auto hit : first.cycle_hits)
+            if (hit + period_start < min_cyclic_step && is_common_hit(hit + period_start))
+                return hit + period_start;
+
+    if (std::ranges::any_of(ghosts, [](const ghost_cycle& g) { return g.cycle_hits.empty(); }))
+        return std::nullopt;
+
+    // every choice of one cycle hit per ghost yields a congruence system; the ghosts are folded in one at a time (the
+    // ones with the fewest hits first), keeping only the solvable systems and each of them once. all systems share
+    // the modulus (the lcm of the periods folded in so far), so they are told apart by their remainder
+    std::vector order { std::from_range, ghosts | std::views::transform([](const ghost_cycle& g) { return &g; }) };
+    std::ranges::sort(order, {}, [](const ghost_cycle* g) { return g->cycle_hits.size(); });
+
+    std::vector<congruence> systems { congruence {} };
+    auto remaining = std::span { order };
+
+    for (; !remaining.empty() && systems.size() * remaining.front()->cycle_hits.size() <= max_num_congruence_systems; remaining = remaining.subspan(1)) {
+        const auto& ghost = *remaining.front();
+        std::vector<congruence> folded;
+
+        for (const auto& system : systems)
+            for (const auto hit : ghost.cycle_hits)
+                if (const auto combined = combine(system, { .remainder = hit % ghost.period, .modulus = ghost.period }))
+                    folded.push_back(*combined);
+
+        std::ranges::sort(folded, {}, &congruence::remainder);
+        const auto duplicates = std::ranges::unique(folded, {}, &congruence::remainder);
+        folded.erase(duplicates.begin(), duplicates.end());
+
+        if (folded.empty())
+            return std::nullopt;
+
+        systems = std::move(folded);
+    }
+
+    const auto modulus = systems.front().modulus;
+
+    if (remaining.empty()) {
+        std::optional<size_t> result;
+
+        for (const auto& system : systems) {
+            const auto remainder = system.remainder;
+            const auto step = remainder >= min_cyclic_step ? quxflux::uint128 { remainder } : remainder + quxflux::uint128 { modulus } * ((min_cyclic_step - remainder + modulus - 1) / modulus);
+
+            if (step <= std::numeric_limits<size_t>::max() && (!result || step < *result))
+                result = static_cast<size_t>(step);
+        }
+
+        return result;
+    }
+
+    // too many systems to fold in the remaining ghosts: the solutions of the systems are enumerated in ascending order
+    // and checked against the remaining ghosts instead. the combined pattern repeats after lcm(modulus, periods of the
+    // remaining ghosts), which is num_blocks times the modulus
+    size_t num_blocks = 1;
+    for (const auto* ghost : remaining) {
+        const auto factor = ghost->period / std::gcd(ghost->period, modulus);
+        const auto lcm = quxflux::uint128 { num_blocks / std::gcd(num_blocks, factor) } * factor;
+
+        if (lcm > std::numeric_limits<size_t>::max())
+            throw std::overflow_error("combined period exceeds 64 bit");
+
+        num_blocks = static_cast<size_t>(lcm);
+    }
+
+    const auto first_block = min_cyclic_step / modulus;
+
+    // one more block, as the first one is partially before min_cyclic_step
+    for (quxflux::uint128 block = first_block; block <= quxflux::uint128 { first_block } + num_blocks; ++block) {
+        for (const auto& system : systems) {
+            const auto step = system.remainder + block * modulus;
+
+            if (step > std::numeric_limits<size_t>::max())
+                return std::nullopt;
+
+            if (step >= min_cyclic_step && std::ranges::all_of(remaining, [&](const ghost_cycle* g) { return is_hit(*g, static_cast<size_t>(step)); }))
+                return static_cast<size_t>(step);
+        }
+    }
+
+    return std::nullopt;
+}
+
+// the network renumbered such that the end nodes take the highest ids, a node is an end node iff its id is at least
+// first_end; the successors are split by direction so that every step gathers from a single array
+struct lockstep_network {
+    std::vector<node_id> left;
+    std::vector<node_id> right;
+    std::vector<node_id> renumbered;
+    node_id first_end = 0;
+};
+
+lockstep_network compile_lockstep_network(const network& net, const std::span<const uint8_t> is_end)
+{
+    const size_t num_nodes = net.next.size();
+
+    std::vector order { std::from_range, std::views::iota(node_id { 0 }, static_cast<node_id>(num_nodes)) };
+    const auto ends = std::ranges::stable_partition(order, [&](const node_id node) { return !is_end[node]; });
+
+    lockstep_network result { .left = std::vector<node_id>(num_nodes), .right = std::vector<node_id>(num_nodes), .renumbered = std::vector<node_id>(num_nodes) };
+    result.first_end = static_cast<node_id>(std::ranges::distance(order.begin(), ends.begin()));
+
+    for (const auto [new_id, old_id] : std::views::enumerate(order))
+        result.renumbered[old_id] = static_cast<node_id>(new_id);
+
+    for (const auto [new_id, old_id] : std::views::enumerate(order)) {
+        result.left[new_id] = result.renumbered[net.next[old_id][0]];
+        result.right[new_id] = result.renumbered[net.next[old_id][1]];
+    }
+
+    return result;
+}
+
+// direct simulation of all ghosts walking in lockstep, for validation and inputs without usable cycle structure;
+// every step gathers the successors of all ghosts and checks them with a single min reduction, both loops being
+// over fixed size groups of lanes so that they vectorize
+std::optional<size_t> simulate_ghosts(const instructions& pattern, const network& net, const std::span<const uint8_t> is_end, const std::span<const node_id> start_nodes, const size_t max_num_steps)
+{
+    constexpr size_t lane_width = 16;
+
+    if (pattern.size == 0)
+        throw std::invalid_argument("empty instruction pattern");
+
+    if (start_nodes.empty())
+        return std::nullopt;
+
+    const auto compiled = compile_lockstep_network(net, is_end);
+
+    // the last group is padded with copies of the first ghost
+    std::vector<node_id> nodes((start_nodes.size() + lane_width - 1) / lane_width * lane_width, compiled.renumbered[start_nodes.front()]);
+    std::ranges::transform(start_nodes, nodes.begin(), [&](const node_id node) { return compiled.renumbered[node]; });
+
+    for (size_t num_steps = 0; num_steps < max_num_steps;) {
+        for (size_t instruction = 0; instruction < pattern.size && num_steps < max_num_steps; ++instruction) {
+            const node_id* successors = pattern.is_right(instruction) ? compiled.right.data() : compiled.left.data();
+            node_id min_node = std::numeric_limits<node_id>::max();
+
+            for (size_t group = 0; group < nodes.size(); group += lane_width) {
+                for (size_t lane = 0; lane < lane_width; ++lane) {
+                    auto& node = nodes[group + lane];
+                    node = successors[node];
+                    min_node = std::min(min_node, node);
+                }
+            }
+
+            ++num_steps;
+
+            if (min_node >= compiled.first_end)
+                return num_steps;
+        }
+    }
+
+    return std::nullopt;
+}
+
+constexpr size_t max_num_steps = size_t { 1 } << 50;
+constexpr size_t max_num_simulated_steps = size_t { 1 } << 24;
+constexpr size_t max_num_fallback_steps = size_t { 1 } << 32;
+
 size_t part_1()
 {
     static constexpr node_name start_node { 'A', 'A', 'A' };
     static constexpr node_name end_node { 'Z', 'Z', 'Z' };
 
-    const auto [pattern, map] = read_input();
-    return calculate_num_steps_required(pattern, map, start_node, std::bind_front(std::equal_to {}, end_node));
+    const auto model = read_input();
+    const auto [pattern, net] = view_of(model);
+
+    // the passes form a functional graph over the nodes: an end node reachable at all is reached within as many
+    // passes as there are nodes
+    const auto table = [&] {
+        const quxflux::allocation_phase phase("jump table");
+        return build_pass_jump_table(pattern, net, mark_nodes(net, std::bind_front(std::equal_to {}, end_node)), net.next.size());
+    }();
+
+    return num_steps_until_end(table, net.id_of(start_node)).value();
 }
 
 size_t part_2()
 {
-    const auto [pattern, map] = read_input();
+    const auto model = read_input();
+    const auto [pattern, net] = view_of(model);
 
     constexpr auto is_start_node = [](const node_name& name) { return name[2] == 'A'; };
     constexpr auto is_end_node = [](const node_name& name) { return name[2] == 'Z'; };
 
-    const std::vector<node_name> start_nodes { std::from_range, map | std::views::keys | std::views::filter(is_start_node) };
+    const auto is_end = mark_nodes(net, is_end_node);
+
+    // the cycle detection only needs the single passes
+    const auto table = [&] {
+        const quxflux::allocation_phase phase("jump table");
+        return build_pass_jump_table(pattern, net, is_end, 1);
+    }();
+
+    const std::vector<node_id> start_nodes { std::from_range, std::views::iota(node_id { 0 }, static_cast<node_id>(net.names.size())) | std::views::filter([&](const node_id id) { return is_start_node(net.names[id]); }) };
+
+    const auto ghosts = [&] {
+        const quxflux::allocation_phase phase("detect cycles");
+
+        std::vector<ghost_cycle> cycles(start_nodes.size());
+        std::transform(std::execution::par, start_nodes.begin(), start_nodes.end(), cycles.begin(), [&](const node_id node) {
+            return detect_cycle(table, pattern, net, node, is_end);
+        });
+        return cycles;
+    }();
+
+    const auto common_hit = [&] {
+        const quxflux::allocation_phase phase("combine cycles");
+        return first_common_hit(ghosts);
+    }();
+
+    // the cycle structure yields no usable answer (e.g. the first common hit exceeds 64 bit), so the ghosts are walked
+    // directly instead
+    if (!common_hit) {
+        const quxflux::allocation_phase phase("simulate ghosts");
+
+        if (const auto num_steps = simulate_ghosts(pattern, net, is_end, start_nodes, max_num_fallback_steps))
+            return *num_steps;
+
+        throw std::runtime_error("the ghosts are not at end nodes at the same time within " + std::to_string(max_num_fallback_steps) + " steps");
+    }
 
-    const std::vector<size_t> cycle_lengths { std::from_range, start_nodes | std::views::transform([&](const node_name& node) {
-                                                 const auto num_steps = calculate_num_steps_required(pattern, map, node, is_end_node);
-                                                 assert(num_steps % pattern.size() == 0);
-                                                 return num_steps / pattern.size();
-                                             }) };
+    const auto num_steps = *common_hit;
+    assert((num_steps > max_num_steps || [&] {
+        const auto validation_table = build_pass_jump_table(pattern, net, is_end, num_steps / pattern.size);
+        return std::ranges::all_of(start_nodes, [&](const node_id node) { return is_end[position_after(validation_table, pattern, net, node, num_steps)] != 0; });
+    }()));
+    assert(num_steps > max_num_simulated_steps || simulate_ghosts(pattern, net, is_end, start_nodes, max_num_simulated_steps) == num_steps);
 
-    return calculate_least_common_multiple(cycle_lengths) * pattern.size();
+    return num_steps;
 }
 
 } // namespace
 
-int main()
+int main(const int argc, char* argv[])
 {
-    std::cout << part_1() << '\n';
-    std::cout << part_2() << '\n';
-    return 0;
+    return quxflux::run_puzzle(8, &part_1, &part_2, QUXFLUX_INPUT_PATH(), argc, argv);
 }
@@ -1,74 +1,241 @@
+#include <aoc23/allocation_stats.h>
+#include <aoc23/driver.h>
+#include <aoc23/line_source.h>
 #include <aoc23/util.h>
 
-#include <spanstream>
+#include <cassert>
+#include <concepts>
+#include <cstdint>
+#include <execution>
+#include <map>
+#include <numeric>
+#include <optional>
+#include <span>
+#include <stdexcept>
 
 namespace {
 
-auto get_input()
+// sequences of equal length stored column major: value i of every sequence forms row i, so that the same step
+// of the extrapolation runs across all sequences in consecutive lanes
+struct sequence_batch {
+    size_t length = 0;
+    size_t num_sequences = 0;
+    std::vector<ptrdiff_t> values;
+
+    [[nodiscard]] std::span<const ptrdiff_t> row(const size_t i) const { return std::span { values }.subspan(i * num_sequences, num_sequences); }
+};
+
+// the sequences of the input, gathered row major per length and handed to process as transposed batches of at most
+// max_batch_size sequences; only the unfinished batches of every length are kept, so memory is bounded by the number of
+// distinct lengths rather than by the size of the input
+void for_each_batch(const std::invocable<const sequence_batch&> auto& process)
 {
-    const auto process_line = [](const std::string_view line) {
-        std::vector<ptrdiff_t> numbers;
+    constexpr size_t max_batch_size = size_t { 1 } << 14;
+
+    std::map<size_t, std::vector<ptrdiff_t>> pending_by_length;
+    std::vector<ptrdiff_t> numbers;
+
+    const auto flush = [&](const size_t length, std::vector<ptrdiff_t>& row_major) {
+        const auto batch = [&] {
+            const quxflux::allocation_phase phase("gather sequences");
+
+            sequence_batch transposed { .length = length, .num_sequences = row_major.size() / length, .values = std::vector<ptrdiff_t>(row_major.size()) };
+
+            for (size_t s = 0; s < transposed.num_sequences; ++s)
+                for (size_t i = 0; i < length; ++i)
+                    transposed.values[i * transposed.num_sequences + s] = row_major[s * length + i];
+
+            row_major.clear();
+            return transposed;
+        }();
+
+        const quxflux::allocation_phase phase("extrapolate");
+        process(batch);
+    };
 
-        std::ispanstream iss { line };
-        std::ranges::copy(std::istream_iterator<ptrdiff_t> { iss }, std::istream_iterator<ptrdiff_t> {}, std::back_inserter(numbers));
+    // parses the line into the pending sequences of its length, which are returned once they make up a full batch
+    const auto gather = [&](std::string_view line) -> std::vector<ptrdiff_t>* {
+        const quxflux::allocation_phase phase("gather sequences");
+        numbers.clear();
 
-        return numbers;
+        while (const auto number = quxflux::consume_int(line))
+            numbers.push_back(*number);
+
+        if (line.find_first_not_of(" \t\r") != std::string_view::npos)
+            throw std::invalid_argument("invalid number");
+
+        if (numbers.empty())
+            return nullptr;
+
+        auto& pending = pending_by_length[numbers.size()];
+        pending.append_range(numbers);
+
+        return pending.size() == max_batch_size * numbers.size() ? &pending : nullptr;
     };
 
-    return quxflux::from_range<std::vector>(QUXFLUX_GET_INPUT() | std::views::split('\n') | std::views::transform(quxflux::as_string_view) | std::views::transform(process_line));
+    for (const auto line : QUXFLUX_GET_INPUT_LINES())
+        if (auto* const full_batch = gather(line))
+            flush(numbers.size(), *full_batch);
+
+    for (auto& [length, pending] : pending_by_length)
+        if (!pending.empty())
+            flush(length, pending);
 }
 
-struct add_last { };
-struct subtract_from_first { };
+// extrapolated values of a batch's sequences, modulo 2^64 (see binomial_weights)
+struct extrapolations {
+    std::vector<uint64_t> previous;
+    std::vector<uint64_t> next;
+
+    explicit extrapolations(const size_t n)
+        : previous(n)
+        , next(n)
+    {
+    }
+};
+
+// the extrapolation of n numbers equals the one of the polynomial of degree < n through them, so both values are dot
+// products of the numbers with alternating binomial coefficients:
+//   x[n] = sum_i (-1)^(n-1-i) * C(n, i) * x[i],  x[-1] = sum_i (-1)^i * C(n, i+1) * x[i]
+// the coefficients and the products exceed 64 bit long before the extrapolated values do, hence everything is computed
+// in unsigned arithmetic modulo 2^64; the result is exact whenever the extrapolated value fits into ptrdiff_t
+struct binomial_weights {
+    std::vector<uint64_t> previous;
+    std::vector<uint64_t> next;
+
+    explicit binomial_weights(const size_t n)
+        : previous(n)
+        , next(n)
+    {
+        // row n of pascal's triangle, built by additions only as they stay exact modulo 2^64
+        std::vector<uint64_t> binomials(n + 1);
+        binomials[0] = 1;
+
+        for (size_t row = 1; row <= n; ++row)
+            for (size_t k = row; k > 0; --k)
+                binomials[k] += binomials[k - 1];
+
+        for (size_t i = 0; i < n; ++i) {
+            next[i] = (n - 1 - i) % 2 == 0 ? binomials[i] : 0 - binomials[i];
+            previous[i] = i % 2 == 0 ? binomials[i + 1] : 0 - binomials[i + 1];
+        }
+    }
+};
+
+// extrapolates the sequences [first, last) of the batch as dot products with the binomial weights, accumulated row by row
+void extrapolate(const sequence_batch& batch, const binomial_weights& weights, const size_t first, const size_t last, extrapolations& result)
+{
+    for (size_t i = 0; i < batch.length; ++i) {
+        const auto row = batch.row(i);
+        const auto w_previous = weights.previous[i];
+        const auto w_next = weights.next[i];
+
+        for (size_t s = first; s < last; ++s) {
+            result.previous[s] += w_previous * static_cast<uint64_t>(row[s]);
+            result.next[s] += w_next * static_cast<uint64_t>(row[s]);
+        }
+    }
+}
 
-template <typename Op>
-auto solve(const std::span<const ptrdiff_t> numbers)
+// difference engine on the sequences [first, last) of the batch: a scratch copy of their columns is repeatedly replaced
+// by its differences in place while the extrapolated values are accumulated from the last and first row of every level
+// (modulo 2^64 like the binomial weights; a level of zeros modulo 2^64 leaves only zeros to follow)
+void extrapolate(const sequence_batch& batch, const size_t first, const size_t last, extrapolations& result)
 {
-    auto buf = quxflux::from_range<std::vector>(numbers);
-    std::vector<ptrdiff_t> last_elements;
+    const size_t width = last - first;
 
-    constexpr auto make_adjacent_diff = std::views::adjacent_transform<2>([](const auto lhs, const auto rhs) { return rhs - lhs; });
+    std::vector<uint64_t> scratch(batch.length * width);
+    for (size_t i = 0; i < batch.length; ++i)
+        std::ranges::transform(batch.row(i).subspan(first, width), scratch.begin() + static_cast<ptrdiff_t>(i * width), [](const ptrdiff_t x) { return static_cast<uint64_t>(x); });
 
-    while (!std::ranges::all_of(buf, std::bind_front(std::equal_to {}, ptrdiff_t { 0 }))) {
-        last_elements.push_back(std::same_as<Op, add_last> ? buf.back() : buf.front());
-        buf = quxflux::from_range<std::vector>(quxflux::from_range<std::vector>(buf | make_adjacent_diff));
-    }
+    const auto row = [&](const size_t i) { return std::span { scratch }.subspan(i * width, width); };
+
+    bool negate = false;
 
-    size_t sum = 0;
+    for (size_t size = batch.length; size > 0; --size) {
+        const auto first_row = row(0);
+        const auto last_row = row(size - 1);
 
-    while (!last_elements.empty()) {
-        if constexpr (std::same_as<Op, add_last>)
-            sum = sum + last_elements.back();
-        else
-            sum = last_elements.back() - sum;
+        for (size_t s = 0; s < width; ++s) {
+            result.next[first + s] += last_row[s];
+            result.previous[first + s] += negate ? 0 - first_row[s] : first_row[s];
+        }
 
-        last_elements.pop_back();
+        negate = !negate;
+
+        bool all_zero = true;
+        for (size_t i = 0; i + 1 < size; ++i) {
+            const auto current = row(i);
+            const auto successor = row(i + 1);
+
+            for (size_t s = 0; s < width; ++s) {
+                current[s] = successor[s] - current[s];
+                all_zero &= current[s] == 0;
+            }
+        }
+
+        if (all_zero)
+            break;
     }
+}
 
-    return sum;
+// extrapolates all sequences of the batch, chunks of sequences being processed concurrently
+extrapolations extrapolate(const sequence_batch& batch)
+{
+    constexpr size_t min_chunk_size = 1 << 12;
+
+    extrapolations result(batch.num_sequences);
+
+    const auto chunks = quxflux::chunk_ranges(batch.num_sequences, quxflux::num_parallel_chunks(batch.num_sequences, min_chunk_size));
+    const binomial_weights weights(batch.length);
+
+    std::for_each(std::execution::par, chunks.begin(), chunks.end(), [&](const std::pair<size_t, size_t>& chunk) {
+        const auto [first, last] = chunk;
+        extrapolate(batch, weights, first, last, result);
+    });
+
+    assert([&] {
+        extrapolations check(batch.num_sequences);
+        extrapolate(batch, 0, batch.num_sequences, check);
+        return check.previous == result.previous && check.next == result.next;
+    }());
+
+    return result;
 }
 
-template <typename Op>
-size_t solve_with_op()
+struct extrapolation {
+    ptrdiff_t previous = 0;
+    ptrdiff_t next = 0;
+};
+
+// sums of the extrapolated previous and next values of all sequences, accumulated modulo 2^64 as well
+extrapolation solve()
 {
-    return std::ranges::fold_left(get_input() | std::views::transform(&solve<Op>), ptrdiff_t { 0 }, std::plus {});
+    uint64_t previous = 0;
+    uint64_t next = 0;
+
+    for_each_batch([&](const sequence_batch& batch) {
+        const auto e = extrapolate(batch);
+        previous += std::reduce(e.previous.begin(), e.previous.end());
+        next += std::reduce(e.next.begin(), e.next.end());
+    });
+
+    return { .previous = static_cast<ptrdiff_t>(previous), .next = static_cast<ptrdiff_t>(next) };
 }
 
-size_t part_1()
+ptrdiff_t part_1()
 {
-    return solve_with_op<add_last>();
+    return solve().next;
 }
 
-size_t part_2()
+ptrdiff_t part_2()
 {
-    return solve_with_op<subtract_from_first>();
+    return solve().previous;
 }
 
 } // namespace
 
-int main()
+int main(const int argc, char* argv[])
 {
-    std::cout << part_1() << '\n';
-    std::cout << part_2() << '\n';
-    return 0;
+    return quxflux::run_puzzle(9, &part_1, &part_2, QUXFLUX_INPUT_PATH(), argc, argv);
 }
@@ -1,8 +1,15 @@
+#include <aoc23/allocation_stats.h>
+#include <aoc23/driver.h>
 #include <aoc23/map.h>
 #include <aoc23/util.h>
 
-#include <set>
-#include <stack>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <execution>
+#include <optional>
+#include <stdexcept>
 #include <utility>
 
 namespace quxflux::aoc {
@@ -18,7 +25,7 @@ namespace {
         start
     };
 
-    map<field> get_input()
+    map<field> parse_input()
     {
         constexpr auto map_element = [](const char c) {
             constexpr auto map_values = std::to_array<std::pair<char, field>>({ //
@@ -37,183 +44,297 @@ namespace {
         return read_map<field>(QUXFLUX_GET_INPUT(), map_element);
     }
 
+    // to be raised whenever field changes, as the map is stored as is in the snapshots
+    constexpr uint32_t map_model_version = 1;
+
+    map<field> get_input()
+    {
+        const auto model = quxflux::load_model(10, map_model_version, QUXFLUX_GET_INPUT(), [] {
+            quxflux::snapshot_writer writer;
+            add_sections(writer, parse_input());
+            return writer;
+        }, [](const quxflux::snapshot& s) { return s.num_sections() == 2 && holds_map<field>(s, 0, [](const field f) { return f <= field::start; }); });
+
+        return map_from_sections<field>(model, 0);
+    }
+
     using position = std::pair<ptrdiff_t, ptrdiff_t>;
-    constexpr std::vector<position> possible_neighbors(const field p)
+
+    enum class direction : uint8_t {
+        north,
+        east,
+        south,
+        west
+    };
+
+    constexpr std::array all_directions { direction::north, direction::east, direction::south, direction::west };
+
+    constexpr direction opposite(const direction d)
+    {
+        return static_cast<direction>((std::to_underlying(d) + 2) % all_directions.size());
+    }
+
+    constexpr position offset(const direction d)
+    {
+        constexpr auto offsets = std::to_array<position>({ { -1, 0 }, { 0, 1 }, { 1, 0 }, { 0, -1 } });
+        return offsets[std::to_underlying(d)];
+    }
+
+    constexpr uint8_t bit(const direction d)
+    {
+        return uint8_t { 1 } << std::to_underlying(d);
+    }
+
+    // the set of directions a field connects to as bit mask
+    constexpr uint8_t connections(const field f)
     {
-        switch (p) {
+        switch (f) {
         case field::none:
-            return {};
+            return 0;
         case field::NS:
-            return { { -1, 0 }, { 1, 0 } };
+            return bit(direction::north) | bit(direction::south);
         case field::WE:
-            return { { 0, -1 }, { 0, 1 } };
+            return bit(direction::west) | bit(direction::east);
         case field::NE:
-            return { { -1, 0 }, { 0, 1 } };
+            return bit(direction::north) | bit(direction::east);
         case field::NW:
-            return { { -1, 0 }, { 0, -1 } };
+            return bit(direction::north) | bit(direction::west);
         case field::SW:
-            return { { 1, 0 }, { 0, -1 } };
+            return bit(direction::south) | bit(direction::west);
         case field::SE:
-            return { { 1, 0 }, { 0, 1 } };
+            return bit(direction::south) | bit(direction::east);
         case field::start:
-            return { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+            return bit(direction::north) | bit(direction::east) | bit(direction::south) | bit(direction::west);
         }
 
         std::unreachable();
     }
 
-    std::vector<position> find_loop_inner(const position current_pos, const position rel_origin, const map<field>& m, std::set<position>& visited)
+    constexpr bool connects(const field f, const direction d)
+    {
+        return (connections(f) & bit(d)) != 0;
+    }
+
+    std::optional<position> neighbor(const map<field>& m, const position pos, const direction d)
     {
-        std::vector<std::vector<position>> found_paths_to_start;
+        const auto [d_r, d_c] = offset(d);
+        const position result { pos.first + d_r, pos.second + d_c };
+
+        if (result.first < 0 || result.first >= static_cast<ptrdiff_t>(m.rows()) || //
+            result.second < 0 || result.second >= static_cast<ptrdiff_t>(m.cols()))
+            return std::nullopt;
+
+        return result;
+    }
+
+    // the loop through the start tile as the directions of its steps, the last step returning to start
+    struct loop {
+        position start;
+        std::vector<direction> steps;
+    };
 
-        const auto current_value = m(current_pos.first, current_pos.second);
+    // follows the pipes from the start tile, trying each direction the start tile may connect to until one leads back
+    loop trace_loop(const map<field>& m)
+    {
+        auto indices = index_view(m);
 
-        if (current_value == field::start)
-            found_paths_to_start.push_back({ current_pos });
+        const auto [start_row, start_col] = *std::ranges::find_if(indices, [&](const auto indices) {
+            const auto [row, col] = indices;
+            return m(row, col) == field::start;
+        });
 
-        for (auto delta_pos : possible_neighbors(current_value)) {
+        const position start { start_row, start_col };
+        std::vector<bool> visited(m.rows() * m.cols());
 
-            if (delta_pos == rel_origin)
-                continue;
+        for (const auto first_direction : all_directions) {
+            loop result { .start = start, .steps = {} };
+            visited.assign(visited.size(), false);
 
-            const auto offset_pos = position { current_pos.first + delta_pos.first, current_pos.second + delta_pos.second };
+            position pos = start;
+            direction dir = first_direction;
 
-            if (offset_pos.first < 0 || offset_pos.first >= m.rows() || //
-                offset_pos.second < 0 || offset_pos.second >= m.cols())
-                continue;
+            while (true) {
+                const auto next = neighbor(m, pos, dir);
+                if (!next || !connects(m(next->first, next->second), opposite(dir)))
+                    break;
 
-            if (visited.contains(offset_pos))
-                continue;
+                pos = *next;
+                result.steps.push_back(dir);
 
-            visited.insert(offset_pos);
+                const auto f = m(pos.first, pos.second);
+                if (f == field::start)
+                    return result;
 
-            auto path = find_loop_inner(offset_pos, { -delta_pos.first, -delta_pos.second }, m, visited);
+                const auto idx = static_cast<size_t>(pos.first) * m.cols() + static_cast<size_t>(pos.second);
+                if (visited[idx])
+                    break;
+                visited[idx] = true;
 
-            if (!path.empty()) {
-                path.insert(path.begin(), current_pos);
-                found_paths_to_start.push_back(std::move(path));
+                dir = static_cast<direction>(std::countr_zero(static_cast<unsigned>(connections(f) & ~bit(opposite(dir)))));
             }
         }
 
-        if (found_paths_to_start.empty())
-            return {};
+        throw std::invalid_argument("no loop through the start tile");
+    }
+
+    // calls f with every position of the loop, starting with the one after start and ending with start
+    void for_each_position(const loop& l, const auto& f)
+    {
+        position pos = l.start;
+
+        for (const auto dir : l.steps) {
+            const auto [d_r, d_c] = offset(dir);
+            pos = { pos.first + d_r, pos.second + d_c };
+            f(pos);
+        }
+    }
+
+    // the shape of the start tile follows from the loop's first step and the one returning to it
+    field start_field(const loop& l)
+    {
+        const auto start_connections = bit(l.steps.front()) | bit(opposite(l.steps.back()));
+
+        for (const auto f : { field::NS, field::WE, field::NE, field::NW, field::SW, field::SE })
+            if (connections(f) == start_connections)
+                return f;
 
-        return std::ranges::max(found_paths_to_start, std::less {}, [](const auto& t) { return t.size(); });
+        std::unreachable();
     }
 
-    auto find_loop(const map<field>& m)
+    // shoelace formula for twice the area enclosed by the loop through the tile centers, Pick's theorem then yields the
+    // number of tiles strictly inside: A = I + B / 2 - 1
+    size_t count_enclosed_tiles(const loop& l)
     {
-        auto indices = index_view(m);
+        ptrdiff_t twice_area = 0;
+        position prev = l.start;
 
-        const auto [start_row, start_col] = *std::ranges::find_if(indices, [&](const auto indices) {
-            const auto [row, col] = indices;
-            return m(row, col) == field::start;
+        for_each_position(l, [&](const position pos) {
+            twice_area += prev.first * pos.second - pos.first * prev.second;
+            prev = pos;
         });
 
-        std::set<std::pair<ptrdiff_t, ptrdiff_t>> visited;
-        return find_loop_inner({ start_row, start_col }, { 0, 0 }, m, visited);
+        const auto boundary = static_cast<ptrdiff_t>(l.steps.size());
+        return static_cast<size_t>((std::abs(twice_area) - boundary) / 2 + 1);
     }
 
-    map<field> scale_up(const map<field>& m)
+    // scanline alternative to count_enclosed_tiles: walking along a row, every crossed loop tile connecting to the north
+    // toggles between outside and inside
+    size_t count_enclosed_tiles(const map<field>& m, const loop& l)
     {
-        map<field> up_scaled(m.rows() * 3, m.cols() * 3);
-        std::ranges::fill(up_scaled.data(), field::none);
+        std::vector<bool> on_loop(m.rows() * m.cols());
+        for_each_position(l, [&](const position pos) { on_loop[static_cast<size_t>(pos.first) * m.cols() + static_cast<size_t>(pos.second)] = true; });
 
-        for (const auto [r, c] : index_view(m)) {
-            const auto t = m(r, c);
+        const auto start = start_field(l);
+        size_t num_enclosed = 0;
 
-            if (t == field::none)
-                continue;
+        for (size_t r = 0; r < m.rows(); ++r) {
+            bool inside = false;
+
+            for (size_t c = 0; c < m.cols(); ++c) {
+                if (!on_loop[r * m.cols() + c]) {
+                    num_enclosed += inside;
+                    continue;
+                }
 
-            up_scaled(r * 3, c * 3) = field::start;
-            for (const auto [d_r, d_c] : possible_neighbors(t))
-                up_scaled(r * 3 + d_r, c * 3 + d_c) = field::start;
+                const auto f = m(r, c) == field::start ? start : m(r, c);
+                inside ^= connects(f, direction::north);
+            }
         }
 
-        return up_scaled;
+        return num_enclosed;
     }
 
-    map<field> scale_down(const map<field>& m)
+    constexpr uint8_t free_cell = 0;
+    constexpr uint8_t pipe_cell = 1;
+    constexpr uint8_t outside_cell = 2;
+
+    // the loop drawn at three times the resolution, every tile becoming 3x3 cells with its pipe through the center, and
+    // surrounded by a free border; the gaps between adjacent pipes become free cells this way, so everything outside
+    // of the loop is connected to the border
+    map<uint8_t> draw_loop(const map<field>& m, const loop& l)
     {
-        map<field> down_scaled(m.rows() / 3, m.cols() / 3);
-        std::ranges::fill(down_scaled.data(), field::none);
+        map<uint8_t> cells(m.rows() * 3 + 2, m.cols() * 3 + 2);
+        const auto start = start_field(l);
 
-        for (const auto [r, c] : index_view(down_scaled)) {
-            const auto t = m(r * 3, c * 3);
+        for_each_position(l, [&](const position pos) {
+            const auto f = m(static_cast<size_t>(pos.first), static_cast<size_t>(pos.second));
+            const position center { pos.first * 3 + 2, pos.second * 3 + 2 };
 
-            if (t == field::none)
-                continue;
+            cells(static_cast<size_t>(center.first), static_cast<size_t>(center.second)) = pipe_cell;
 
-            down_scaled(r, c) = t;
-        }
+            for (const auto d : all_directions) {
+                if (!connects(f == field::start ? start : f, d))
+                    continue;
 
-        return down_scaled;
+                const auto [d_r, d_c] = offset(d);
+                cells(static_cast<size_t>(center.first + d_r), static_cast<size_t>(center.second + d_c)) = pipe_cell;
+            }
+        });
+
+        return cells;
     }
 
-    void flood_fill(const position start_pos, map<field>& m, const field fill_value = field::WE)
+    // counts the tiles whose center cell in the drawn loop satisfies is_enclosed
+    size_t count_tiles(const map<field>& m, const auto& is_enclosed)
     {
-        std::stack<position> stack;
-        stack.push(start_pos);
+        size_t num_enclosed = 0;
 
-        while (!stack.empty()) {
-            const auto pos = stack.top();
-            stack.pop();
+        for (size_t r = 0; r < m.rows(); ++r)
+            for (size_t c = 0; c < m.cols(); ++c)
+                num_enclosed += is_enclosed(r * 3 + 2, c * 3 + 2);
 
-            if (m(pos.first, pos.second) != field::none)
-                continue;
-
-            m(pos.first, pos.second) = fill_value;
+        return num_enclosed;
+    }
 
-            for (const auto delta_pos : std::to_array<position>({ { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } })) {
-                const auto offset_pos = position { pos.first + delta_pos.first, pos.second + delta_pos.second };
+    // flood fill alternative to count_enclosed_tiles: filling the drawn loop from its border reaches every cell outside
+    // of the loop, the free cells left are enclosed
+    size_t count_enclosed_tiles_by_flood_fill(const map<field>& m, const loop& l)
+    {
+        auto cells = draw_loop(m, l);
+        flood_fill(cells, 0, 0, outside_cell);
 
-                if (offset_pos.first < 0 || offset_pos.first >= m.rows() || //
-                    offset_pos.second < 0 || offset_pos.second >= m.cols())
-                    continue;
+        return count_tiles(m, [&](const size_t r, const size_t c) { return cells(r, c) == free_cell; });
+    }
 
-                if (m(offset_pos.first, offset_pos.second) != field::none)
-                    continue;
+    // region labelling alternative to count_enclosed_tiles: the free cells not in the border's region are enclosed
+    size_t count_enclosed_tiles_by_labels(const map<field>& m, const loop& l)
+    {
+        const auto cells = draw_loop(m, l);
+        const auto regions = label_regions(std::execution::par, cells);
+        const auto outside = regions.labels(0, 0);
 
-                stack.push(offset_pos);
-            }
-        }
+        return count_tiles(m, [&](const size_t r, const size_t c) { return cells(r, c) == free_cell && regions.labels(r, c) != outside; });
     }
 
     size_t part_1()
     {
         const auto map = get_input();
-        return (find_loop(map).size() - 2) / 2 + 1;
+
+        const quxflux::allocation_phase phase("trace loop");
+        return trace_loop(map).steps.size() / 2;
     }
 
     size_t part_2()
     {
         const auto input_map = get_input();
-        auto masked_map = input_map;
-        const auto loop = find_loop(input_map);
-
-        std::ranges::fill(masked_map.data(), field::none);
-        for (const auto [r, c] : loop)
-            masked_map(r, c) = input_map(r, c);
-
-        masked_map(loop.front().first, loop.front().second) = field::SW;
-
-        map up_scaled = scale_up(masked_map);
-
-        flood_fill({ 0, 0 }, up_scaled);
-        flood_fill({ up_scaled.rows() - 1, 0 }, up_scaled);
-        flood_fill({ 0, up_scaled.cols() - 1 }, up_scaled);
-        flood_fill({ up_scaled.rows() - 1, up_scaled.cols() - 1 }, up_scaled);
-
-        const auto down_scaled = scale_down(up_scaled);
-        return std::ranges::count(down_scaled.data(), field::none);
+        const auto loop = [&] {
+            const quxflux::allocation_phase phase("trace loop");
+            return trace_loop(input_map);
+        }();
+
+        const quxflux::allocation_phase phase("count enclosed tiles");
+        const auto num_enclosed = count_enclosed_tiles(loop);
+        assert(num_enclosed == count_enclosed_tiles(input_map, loop));
+        assert(num_enclosed == count_enclosed_tiles_by_flood_fill(input_map, loop));
+        assert(num_enclosed == count_enclosed_tiles_by_labels(input_map, loop));
+
+        return num_enclosed;
     }
 
 } // namespace
 }
 
-int main()
+int main(const int argc, char* argv[])
 {
-    std::cout << quxflux::aoc::part_1() << '\n';
-    std::cout << quxflux::aoc::part_2() << '\n';
-    return 0;
+    return quxflux::run_puzzle(10, &quxflux::aoc::part_1, &quxflux::aoc::part_2, QUXFLUX_INPUT_PATH(), argc, argv);
 }
@@ -1,7 +1,13 @@
+#include <aoc23/allocation_stats.h>
+#include <aoc23/driver.h>
 #include <aoc23/map.h>
 #include <aoc23/util.h>
 
-#include <set>
+#include <cassert>
+#include <cstdint>
+#include <random>
+#include <span>
+#include <stdexcept>
 #include <utility>
 
 namespace quxflux::aoc {
@@ -19,9 +25,19 @@ namespace {
         return os << std::to_underlying(f);
     }
 
+    // to be raised whenever field changes, as the map is stored as is in the snapshots
+    constexpr uint32_t map_model_version = 1;
+
+    // any cell other than a galaxy counts as empty, so there is nothing to validate in the cells of a snapshot
     map<field> read_input()
     {
-        return read_map<field>(QUXFLUX_GET_INPUT(), [](const char c) { return static_cast<field>(c); });
+        const auto model = quxflux::load_model(11, map_model_version, QUXFLUX_GET_INPUT(), [] {
+            quxflux::snapshot_writer writer;
+            add_sections(writer, read_map<field>(QUXFLUX_GET_INPUT(), [](const char c) { return static_cast<field>(c); }));
+            return writer;
+        }, [](const quxflux::snapshot& s) { return s.num_sections() == 2 && holds_map<field>(s, 0, [](field) { return true; }); });
+
+        return map_from_sections<field>(model, 0);
     }
 
     auto row_view(auto& m, const size_t row_idx)
@@ -44,115 +60,319 @@ namespace {
         return galaxy_positions;
     }
 
-    auto num_duplicates(const auto& data)
+    // sum of |x_i - x_k| over all pairs of coordinates: once sorted, every coordinate contributes its distance to each of
+    // its predecessors, that is index * x minus the running sum of the predecessors
+    size_t sum_of_pairwise_distances(std::vector<size_t> coords)
     {
-        return data.size() - from_range<std::set>(data).size();
-    }
+        std::ranges::sort(coords);
 
-    auto gen_pairs(const std::span<const position> positions)
-    {
-        std::vector<std::pair<position, position>> all_pairs;
-        all_pairs.reserve((positions.size() * (positions.size() - 1)) / 2);
+        size_t sum = 0;
+        size_t prefix_sum = 0;
 
-        for (size_t i = 0; i < positions.size(); ++i)
-            for (size_t k = i + 1; k < positions.size(); ++k)
-                all_pairs.emplace_back(positions[i], positions[k]);
+        for (const auto [idx, x] : std::views::enumerate(coords)) {
+            sum += static_cast<size_t>(idx) * x - prefix_sum;
+            prefix_sum += x;
+        }
 
-        return all_pairs;
+        return sum;
     }
 
-    auto calculate_expanded_rows_and_cols(const map<field>& m)
+    size_t sum_of_pairwise_distances(const std::span<const position> positions)
     {
-        std::vector<size_t> to_expand_cols {};
-        std::vector<size_t> to_expand_rows {};
+        return sum_of_pairwise_distances(std::vector<size_t> { std::from_range, positions | std::views::elements<0> }) + //
+            sum_of_pairwise_distances(std::vector<size_t> { std::from_range, positions | std::views::elements<1> });
+    }
+
+    // indices of the rows and columns without any galaxy
+    auto calculate_empty_rows_and_cols(const map<field>& m)
+    {
+        std::vector<size_t> empty_cols {};
+        std::vector<size_t> empty_rows {};
 
         std::ranges::copy(std::views::iota(size_t { 0 }, m.cols()) | std::views::filter([&](const size_t col) {
             return std::ranges::count(col_view(m, col), field::empty) == m.rows();
         }),
-            std::back_inserter(to_expand_cols));
+            std::back_inserter(empty_cols));
 
         std::ranges::copy(std::views::iota(size_t { 0 }, m.rows()) | std::views::filter([&](const size_t row) {
             return std::ranges::count(row_view(m, row), field::empty) == m.cols();
         }),
-            std::back_inserter(to_expand_rows));
-
-        std::vector<size_t> combined_rows(m.rows() + to_expand_rows.size());
-        std::ranges::copy(std::views::iota(size_t { 0 }, combined_rows.size()), combined_rows.begin());
-        std::ranges::copy(to_expand_rows, combined_rows.begin() + m.rows());
-        std::ranges::sort(combined_rows);
+            std::back_inserter(empty_rows));
 
-        std::vector<size_t> combined_cols(m.cols() + to_expand_cols.size());
-        std::ranges::copy(std::views::iota(size_t { 0 }, combined_cols.size()), combined_cols.begin());
-        std::ranges::copy(to_expand_cols, combined_cols.begin() + m.cols());
-        std::ranges::sort(combined_cols);
-
-        return std::pair { std::move(combined_rows), std::move(combined_cols) };
+        return std::pair { std::move(empty_rows), std::move(empty_cols) };
     }
 
-    map<field> expand(const map<field>& m)
+    // number of empty lines preceding x
+    size_t num_empty_before(const size_t x, const std::span<const size_t> empty_lines)
     {
-        const auto [combined_rows, combined_cols] = calculate_expanded_rows_and_cols(m);
-        map<field> expanded(combined_rows.size(), combined_cols.size());
-
-        for (const auto [dst_row, src_row] : std::views::enumerate(combined_rows))
-            for (const auto [dst_col, src_col] : std::views::enumerate(combined_cols))
-                expanded(dst_row, dst_col) = m(src_row, src_col);
-
-        return expanded;
+        return static_cast<size_t>(std::ranges::distance(empty_lines.begin(), std::ranges::lower_bound(empty_lines, x)));
     }
 
-    size_t part_1()
-    {
-        const auto data = expand(read_input());
+    // the total distance is affine in the expansion factor f: every empty line crossed between two galaxies adds f - 1
+    // to their unexpanded distance, so both coefficients are computed once and queries take O(1)
+    struct expansion_engine {
+        size_t base_distance = 0;
+        size_t num_crossed_empty_lines = 0;
+
+        // an empty line expands to expansion_factor lines, at least one
+        [[nodiscard]] constexpr size_t total_distance(const size_t expansion_factor) const
+        {
+            if (expansion_factor == 0)
+                throw std::invalid_argument("expansion factor must be at least 1");
 
-        const auto galaxy_positions = calculate_galaxy_positions(data);
+            return base_distance + num_crossed_empty_lines * (expansion_factor - 1);
+        }
+    };
 
-        static constexpr auto dist = [](const position& a, const position& b) {
-            return std::max(a.first, b.first) - std::min(a.first, b.first) + //
-                std::max(a.second, b.second) - std::min(a.second, b.second);
-        };
+    // the empty lines are expected in ascending order; as galaxies never lie on them, the number of empty lines between
+    // two galaxies is the difference of the numbers of empty lines preceding them
+    expansion_engine build_expansion_engine(const std::span<const position> galaxy_positions, const std::span<const size_t> empty_rows, const std::span<const size_t> empty_cols)
+    {
+        const std::vector crossings { std::from_range, galaxy_positions | std::views::transform([&](const position& pos) {
+                                         return position { num_empty_before(pos.first, empty_rows), num_empty_before(pos.second, empty_cols) };
+                                     }) };
 
-        return std::ranges::fold_left(gen_pairs(galaxy_positions) | std::views::transform([](const auto pair) { return std::apply(dist, pair); }), size_t { 0 }, std::plus {});
+        return { .base_distance = sum_of_pairwise_distances(galaxy_positions), .num_crossed_empty_lines = sum_of_pairwise_distances(crossings) };
     }
 
-    size_t part_2()
+    expansion_engine build_expansion_engine(const map<field>& m)
     {
-        const auto data = read_input();
-        const auto [combined_rows, combined_cols] = calculate_expanded_rows_and_cols(data);
+        const auto [empty_rows, empty_cols] = calculate_empty_rows_and_cols(m);
+        return build_expansion_engine(calculate_galaxy_positions(m), empty_rows, empty_cols);
+    }
 
-        const auto galaxy_positions = calculate_galaxy_positions(data);
+    // summary of a range of lines of one axis; merging the summaries of two adjacent ranges accounts for the pairs and
+    // triples spanning both, so crossings (galaxy, empty line, galaxy triples in axis order) is the number of empty lines
+    // crossed summed over all galaxy pairs
+    struct line_summary {
+        size_t num_galaxies = 0;
+        size_t num_empty = 0;
+        size_t coordinate_sum = 0;
+        size_t distance_sum = 0;
+        size_t galaxy_empty_pairs = 0;
+        size_t empty_galaxy_pairs = 0;
+        size_t crossings = 0;
+
+        static constexpr line_summary of_line(const size_t line, const size_t num_galaxies, const bool empty)
+        {
+            return { .num_galaxies = num_galaxies, .num_empty = empty, .coordinate_sum = line * num_galaxies };
+        }
+
+        friend constexpr line_summary merge(const line_summary& lhs, const line_summary& rhs)
+        {
+            return {
+                .num_galaxies = lhs.num_galaxies + rhs.num_galaxies,
+                .num_empty = lhs.num_empty + rhs.num_empty,
+                .coordinate_sum = lhs.coordinate_sum + rhs.coordinate_sum,
+                .distance_sum = lhs.distance_sum + rhs.distance_sum + rhs.coordinate_sum * lhs.num_galaxies - lhs.coordinate_sum * rhs.num_galaxies,
+                .galaxy_empty_pairs = lhs.galaxy_empty_pairs + rhs.galaxy_empty_pairs + lhs.num_galaxies * rhs.num_empty,
+                .empty_galaxy_pairs = lhs.empty_galaxy_pairs + rhs.empty_galaxy_pairs + lhs.num_empty * rhs.num_galaxies,
+                .crossings = lhs.crossings + rhs.crossings + lhs.galaxy_empty_pairs * rhs.num_galaxies + lhs.num_galaxies * rhs.empty_galaxy_pairs,
+            };
+        }
+    };
 
-        constexpr size_t expansion_factor = 1'000'000;
+    // galaxies and empty lines along one axis; a segment tree over the lines keeps the summary of all of them up to date
+    // in O(log n) per change; Fenwick trees would do as well: toggling a line changes the crossings by the number of
+    // galaxies before it times the number after it, and a galaxy changes them by the numbers of empty lines preceding
+    // the galaxies on either side of it, which range update Fenwick trees keep track of. the segment tree gets by with
+    // a single merge for both coefficients instead
+    struct galaxy_axis {
+        std::vector<size_t> num_galaxies;
+        std::vector<uint8_t> empty;
+        std::vector<line_summary> tree;
+        size_t num_leaves = 1;
+
+        explicit galaxy_axis(std::vector<size_t> galaxies_per_line)
+            : num_galaxies(std::move(galaxies_per_line))
+            , empty(num_galaxies.size())
+        {
+            std::ranges::transform(num_galaxies, empty.begin(), [](const size_t n) { return uint8_t { n == 0 }; });
+
+            while (num_leaves < num_galaxies.size())
+                num_leaves *= 2;
+
+            tree.resize(2 * num_leaves);
+
+            for (size_t line = 0; line < num_galaxies.size(); ++line)
+                tree[num_leaves + line] = line_summary::of_line(line, num_galaxies[line], empty[line]);
+
+            for (size_t node = num_leaves - 1; node > 0; --node)
+                tree[node] = merge(tree[2 * node], tree[2 * node + 1]);
+        }
+
+        [[nodiscard]] const line_summary& summary() const { return tree[1]; }
+
+        // adds (or removes) a galaxy on line; a line becomes non empty with its first galaxy and empty with its last
+        void add_galaxy(const size_t line, const bool remove = false)
+        {
+            if (remove && num_galaxies.at(line) == 0)
+                throw std::invalid_argument("no galaxy on line");
+
+            auto& n = num_galaxies.at(line);
+            n = remove ? n - 1 : n + 1;
+            empty[line] = n == 0;
+            update(line);
+        }
+
+        void toggle_empty(const size_t line)
+        {
+            if (num_galaxies.at(line) != 0)
+                throw std::invalid_argument("line holds galaxies");
+
+            empty[line] = !empty[line];
+            update(line);
+        }
+
+    private:
+        void update(const size_t line)
+        {
+            size_t node = num_leaves + line;
+            tree[node] = line_summary::of_line(line, num_galaxies[line], empty[line]);
+
+            for (node /= 2; node > 0; node /= 2)
+                tree[node] = merge(tree[2 * node], tree[2 * node + 1]);
+        }
+    };
 
-        const auto dist = [&](const position& a, const position& b) {
-            const auto max_row = std::max(a.first, b.first);
-            const auto min_row = std::min(a.first, b.first);
+    // galaxy map supporting edits, the expansion engine being kept up to date in O(log n) per edit
+    class dynamic_galaxy_set {
+    public:
+        explicit dynamic_galaxy_set(map<field> m)
+            : map_(std::move(m))
+            , rows_(count_galaxies(map_.rows(), [&](const size_t row) { return std::ranges::count(row_view(map_, row), field::galaxy); }))
+            , cols_(count_galaxies(map_.cols(), [&](const size_t col) { return std::ranges::count(col_view(map_, col), field::galaxy); }))
+        {
+        }
+
+        void insert(const size_t row, const size_t col) { set(row, col, field::galaxy); }
+        void erase(const size_t row, const size_t col) { set(row, col, field::empty); }
+
+        // switches an empty row / column between being expanded or not
+        void toggle_row(const size_t row) { rows_.toggle_empty(row); }
+        void toggle_col(const size_t col) { cols_.toggle_empty(col); }
+
+        [[nodiscard]] expansion_engine engine() const
+        {
+            const auto& rows = rows_.summary();
+            const auto& cols = cols_.summary();
+
+            return { .base_distance = rows.distance_sum + cols.distance_sum, .num_crossed_empty_lines = rows.crossings + cols.crossings };
+        }
+
+    private:
+        static std::vector<size_t> count_galaxies(const size_t num_lines, const auto& count_line)
+        {
+            return std::vector { std::from_range, std::views::iota(size_t { 0 }, num_lines) | std::views::transform([&](const size_t line) { return static_cast<size_t>(count_line(line)); }) };
+        }
+
+        void set(const size_t row, const size_t col, const field f)
+        {
+            if (row >= map_.rows() || col >= map_.cols())
+                throw std::out_of_range("position outside of the map");
+
+            if (map_(row, col) == f)
+                throw std::invalid_argument(f == field::galaxy ? "galaxy already present" : "no galaxy present");
+
+            map_(row, col) = f;
+            rows_.add_galaxy(row, f == field::empty);
+            cols_.add_galaxy(col, f == field::empty);
+        }
+
+        map<field> map_;
+        galaxy_axis rows_;
+        galaxy_axis cols_;
+    };
 
-            const auto max_col = std::max(a.second, b.second);
-            const auto min_col = std::min(a.second, b.second);
+    // applies random edits to a dynamic_galaxy_set and compares its engine after each of them with one built from the
+    // edited map; a line toggled to not be expanded is left out of the empty lines until it receives a galaxy (which
+    // resets the toggle)
+    bool check_dynamic_galaxy_set(map<field> m, const size_t num_edits)
+    {
+        if (m.rows() == 0 || m.cols() == 0)
+            return true;
+
+        dynamic_galaxy_set dynamic(m);
+        std::vector<uint8_t> unexpanded_rows(m.rows());
+        std::vector<uint8_t> unexpanded_cols(m.cols());
+
+        std::mt19937_64 random(m.rows() * m.cols());
+        const auto random_index = [&](const size_t n) { return std::uniform_int_distribution<size_t>(0, n - 1)(random); };
+
+        const auto has_galaxy = [](auto&& line) { return std::ranges::contains(line, field::galaxy); };
+
+        for (size_t edit = 0; edit < num_edits; ++edit) {
+            const auto row = random_index(m.rows());
+            const auto col = random_index(m.cols());
+
+            switch (random_index(3)) {
+            case 0:
+                if (m(row, col) == field::galaxy) {
+                    m(row, col) = field::empty;
+                    dynamic.erase(row, col);
+                } else {
+                    m(row, col) = field::galaxy;
+                    dynamic.insert(row, col);
+                    unexpanded_rows[row] = false;
+                    unexpanded_cols[col] = false;
+                }
+                break;
+            case 1:
+                if (!has_galaxy(row_view(m, row))) {
+                    dynamic.toggle_row(row);
+                    unexpanded_rows[row] = !unexpanded_rows[row];
+                }
+                break;
+            default:
+                if (!has_galaxy(col_view(m, col))) {
+                    dynamic.toggle_col(col);
+                    unexpanded_cols[col] = !unexpanded_cols[col];
+                }
+                break;
+            }
+
+            auto [empty_rows, empty_cols] = calculate_empty_rows_and_cols(m);
+            std::erase_if(empty_rows, [&](const size_t r) { return unexpanded_rows[r] != 0; });
+            std::erase_if(empty_cols, [&](const size_t c) { return unexpanded_cols[c] != 0; });
+
+            const auto expected = build_expansion_engine(calculate_galaxy_positions(m), empty_rows, empty_cols);
+            const auto actual = dynamic.engine();
+
+            if (actual.base_distance != expected.base_distance || actual.num_crossed_empty_lines != expected.num_crossed_empty_lines)
+                return false;
+        }
+
+        return true;
+    }
 
-            const auto row_begin = std::ranges::find(combined_rows, min_row);
-            const auto row_end = std::ranges::find(combined_rows, max_row);
-            const auto num_to_expand_rows = num_duplicates(std::ranges::subrange { row_begin, row_end });
-            const auto num_regular_rows = max_row - min_row - num_to_expand_rows;
+    size_t part_1()
+    {
+        const auto m = read_input();
 
-            const auto col_begin = std::ranges::find(combined_cols, min_col);
-            const auto col_end = std::ranges::find(combined_cols, max_col);
-            const auto num_to_expand_cols = num_duplicates(std::ranges::subrange { col_begin, col_end });
-            const auto num_regular_cols = max_col - min_col - num_to_expand_cols;
+        const quxflux::allocation_phase phase("expansion engine");
+        const auto engine = build_expansion_engine(m);
 
-            return num_regular_cols + num_to_expand_cols * expansion_factor + num_regular_rows + num_to_expand_rows * expansion_factor;
-        };
+        assert(([&] {
+            const auto dynamic_engine = dynamic_galaxy_set(m).engine();
+            return dynamic_engine.base_distance == engine.base_distance && dynamic_engine.num_crossed_empty_lines == engine.num_crossed_empty_lines;
+        }()));
+        assert(check_dynamic_galaxy_set(m, 100));
+
+        return engine.total_distance(2);
+    }
+
+    size_t part_2()
+    {
+        const auto m = read_input();
 
-        return std::ranges::fold_left(gen_pairs(galaxy_positions) | std::views::transform([&](const auto pair) { return std::apply(dist, pair); }), size_t { 0 }, std::plus {});
+        const quxflux::allocation_phase phase("expansion engine");
+        return build_expansion_engine(m).total_distance(1'000'000);
     }
 
 } // namespace
 }
 
-int main()
+int main(const int argc, char* argv[])
 {
-    std::cout << quxflux::aoc::part_1() << '\n';
-    std::cout << quxflux::aoc::part_2() << '\n';
-    return 0;
+    return quxflux::run_puzzle(11, &quxflux::aoc::part_1, &quxflux::aoc::part_2, QUXFLUX_INPUT_PATH(), argc, argv);
 }